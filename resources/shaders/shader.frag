@@ -45,19 +45,31 @@ struct SpotLight{
     float quadratic;
 };
 
-uniform vec3 viewPos;
 uniform Material material;
 
+// Static lights baked on the CPU (LightmapBaker) : diffuse, ambient and one bounce, one layer per object
+layout (binding = 15) uniform sampler2DArray lightmap;
+
+layout (std140, binding = 0) uniform CameraData {
+    mat4 proj;
+    mat4 view;
+    vec3 viewPos;
+};
+
 // Lights
-uniform DirectionalLight dirLight;
 #define NR_POINT_LIGHTS 4  
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
+layout (std140, binding = 2) uniform LightData {
+    DirectionalLight dirLight;
+    PointLight pointLights[NR_POINT_LIGHTS];
+    SpotLight spotLight;
+};
 
 // In
 in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoord;
+in vec2 LightmapCoord;
+flat in int LightmapLayer;
 
 // Out
 out vec4 FragColor;
@@ -74,13 +86,19 @@ void main()
     vec3 norm = normalize(Normal);
     vec3 viewDir = normalize(viewPos - FragPos); 
 
-    // Directional light
-    vec3 result = CalculateDirectionalLight(dirLight, norm, viewDir);
-
-    // Point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++){
-        result += CalculatePointLight(pointLights[i], norm, FragPos, viewDir);
-    };
+    vec3 result;
+    if (LightmapLayer >= 0) {
+        // Directional & point lights : baked
+        result = texture(lightmap, vec3(LightmapCoord, LightmapLayer)).rgb * texture(material.texture_diffuse0, TexCoord).rgb;
+    } else {
+        // Directional light
+        result = CalculateDirectionalLight(dirLight, norm, viewDir);
+
+        // Point lights
+        for(int i = 0; i < NR_POINT_LIGHTS; i++){
+            result += CalculatePointLight(pointLights[i], norm, FragPos, viewDir);
+        };
+    }
 
     // Spot light
     result += CalculateSpotLight(spotLight, norm, FragPos, viewDir);
@@ -3,21 +3,61 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoord;
+layout (location = 3) in vec2 aLightmapCoord;
+layout (location = 4) in uvec4 aBoneIds;
+layout (location = 5) in vec4 aBoneWeights;
 
-uniform mat4 proj;
-uniform mat4 view;
-uniform mat4 model;
+// Per frame and per object data, written by the CPU in a persistently mapped ring buffer
+layout (std140, binding = 0) uniform CameraData {
+    mat4 proj;
+    mat4 view;
+    vec3 viewPos;
+};
+
+layout (std140, binding = 1) uniform ObjectData {
+    mat4 model;
+    mat4 normalMatrix; // transpose(inverse(model)), computed on the CPU
+    int lightmapLayer; // -1 when the static lights are not baked
+    int boneOffset;    // -1 when the mesh is not skinned
+};
+
+// 3 rows per joint, the palettes of every animated instance one after the other
+layout (std430, binding = 3) readonly buffer BonePalette {
+    vec4 boneRows[];
+};
 
 out vec3 FragPos;
 out vec3 Normal;
 out vec2 TexCoord;
+out vec2 LightmapCoord;
+flat out int LightmapLayer;
 
 
+mat4 boneMatrix(uint bone)
+{
+    int row = (boneOffset + int(bone)) * 3;
+    return transpose(mat4(boneRows[row], boneRows[row + 1], boneRows[row + 2], vec4(0.0, 0.0, 0.0, 1.0)));
+}
+
 void main()
 {
-    FragPos = vec3(model * vec4(aPos, 1.0));
-    Normal = mat3(transpose(inverse(model))) * aNormal;
+    vec4 position = vec4(aPos, 1.0);
+    vec3 normal = aNormal;
+    // rigid meshes of a skinned model, and unweighted vertices, keep their bind pose instead of collapsing
+    if (boneOffset >= 0 && dot(aBoneWeights, vec4(1.0)) > 0.0) {
+        mat4 skin = boneMatrix(aBoneIds.x) * aBoneWeights.x
+                  + boneMatrix(aBoneIds.y) * aBoneWeights.y
+                  + boneMatrix(aBoneIds.z) * aBoneWeights.z
+                  + boneMatrix(aBoneIds.w) * aBoneWeights.w;
+        position = skin * position;
+        normal = mat3(skin) * normal; // joint scale is uniform
+    }
+
+    FragPos = vec3(model * position);
+    Normal = mat3(normalMatrix) * normal;
     TexCoord = aTexCoord;
+    LightmapCoord = aLightmapCoord;
+    LightmapLayer = lightmapLayer;
 
-    gl_Position = proj * view * model * vec4(aPos, 1.0);
+    gl_Position = proj * view * model * position;
 }
\ No newline at end of file
@@ -0,0 +1,48 @@
+#version 450
+
+uniform sampler2D source;
+uniform vec2 sourceSize; // allocated size of the render target
+uniform vec2 renderSize; // part of the target actually rendered this frame
+
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+// Keep every tap inside the rendered region, the rest of the target holds stale pixels
+vec3 SampleClamped(vec2 texel)
+{
+    texel = clamp(texel, vec2(0.5), renderSize - 0.5);
+    return textureLod(source, texel / sourceSize, 0.0).rgb;
+}
+
+// Catmull-Rom bicubic filter folded into 5 bilinear taps (the 4 corner taps have negligible weight)
+void main()
+{
+    vec2 samplePos = TexCoord * renderSize;
+    vec2 texPos1 = floor(samplePos - 0.5) + 0.5;
+    vec2 f = samplePos - texPos1;
+
+    vec2 w0 = f * (-0.5 + f * (1.0 - 0.5 * f));
+    vec2 w1 = 1.0 + f * f * (-2.5 + 1.5 * f);
+    vec2 w2 = f * (0.5 + f * (2.0 - 1.5 * f));
+    vec2 w3 = f * f * (-0.5 + 0.5 * f);
+
+    vec2 w12 = w1 + w2;
+    vec2 offset12 = w2 / w12;
+
+    vec2 texPos0 = texPos1 - 1.0;
+    vec2 texPos3 = texPos1 + 2.0;
+    vec2 texPos12 = texPos1 + offset12;
+
+    vec3 result = vec3(0.0);
+    result += SampleClamped(vec2(texPos12.x, texPos0.y)) * w12.x * w0.y;
+    result += SampleClamped(vec2(texPos0.x, texPos12.y)) * w0.x * w12.y;
+    result += SampleClamped(vec2(texPos12.x, texPos12.y)) * w12.x * w12.y;
+    result += SampleClamped(vec2(texPos3.x, texPos12.y)) * w3.x * w12.y;
+    result += SampleClamped(vec2(texPos12.x, texPos3.y)) * w12.x * w3.y;
+
+    float weight = w12.x * w0.y + w0.x * w12.y + w12.x * w12.y + w3.x * w12.y + w12.x * w3.y;
+
+    // Catmull-Rom has negative lobes : clamp the ringing
+    FragColor = vec4(max(result / weight, 0.0), 1.0);
+}
@@ -0,0 +1,149 @@
+#include "animationsystem.h"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+AnimationSystem::AnimationSystem(JobSystem &jobs) :
+	m_poses(jobs.getThreadCount()),
+	m_globals(jobs.getThreadCount()) {
+}
+
+AnimationHandle AnimationSystem::create(const Skeleton &skeleton) {
+
+	Instance instance;
+	instance.skeleton = &skeleton;
+	instance.fade = 0.0f;
+	instance.fadeDuration = 0.0f;
+	instance.paletteOffset = (unsigned int)m_palette.size();
+
+	m_palette.resize(m_palette.size() + skeleton.joints.size());
+	m_instances.push_back(instance);
+	m_stats.instances = m_instances.size();
+
+	return (AnimationHandle)(m_instances.size() - 1);
+}
+
+void AnimationSystem::play(AnimationHandle handle, const AnimationClip *clip, float fadeSeconds, float speed) {
+
+	Instance &instance = m_instances[handle];
+
+	if (clip && clip->jointCount != instance.skeleton->joints.size()) {
+		std::cout << "ERROR::ANIMATION::CLIP_SKELETON_MISMATCH " << clip->name << std::endl;
+		return;
+	}
+
+	instance.previous = instance.current;
+	instance.current.clip = clip;
+	instance.current.time = 0.0f;
+	instance.current.speed = speed;
+	instance.fade = 0.0f;
+	instance.fadeDuration = fadeSeconds;
+}
+
+void AnimationSystem::setSpeed(AnimationHandle handle, float speed) {
+	m_instances[handle].current.speed = speed;
+}
+
+// the bind pose blended in like a clip, for instances that play nothing
+static void sampleBindPose(const Skeleton &skeleton, float weight, JointPose *out) {
+	for (size_t joint = 0; joint < skeleton.joints.size(); joint++) {
+		const SkeletonJoint &bind = skeleton.joints[joint];
+		JointPose &pose = out[joint];
+		if (weight >= 1.0f) {
+			pose.translation = bind.bindTranslation;
+			pose.rotation = bind.bindRotation;
+			pose.scale = bind.bindScale;
+		} else {
+			pose.translation = pose.translation + (bind.bindTranslation - pose.translation) * weight;
+			pose.rotation = glm::normalize(glm::slerp(pose.rotation, bind.bindRotation, weight));
+			pose.scale = pose.scale + (bind.bindScale - pose.scale) * weight;
+		}
+	}
+}
+
+void AnimationSystem::evaluate(const Instance &instance, unsigned int threadIndex) {
+
+	const Skeleton &skeleton = *instance.skeleton;
+	size_t jointCount = skeleton.joints.size();
+
+	std::vector<JointPose> &poses = m_poses[threadIndex];
+	std::vector<glm::mat4> &globals = m_globals[threadIndex];
+	poses.resize(jointCount);
+	globals.resize(jointCount);
+
+	// local poses : the clip fading out first, the current one blended over it
+	float weight = 1.0f;
+	if (instance.fade < instance.fadeDuration) {
+		if (instance.previous.clip) {
+			SampleClip(*instance.previous.clip, instance.previous.time, 1.0f, poses.data());
+		} else {
+			sampleBindPose(skeleton, 1.0f, poses.data());
+		}
+		weight = instance.fade / instance.fadeDuration;
+	}
+	if (instance.current.clip) {
+		SampleClip(*instance.current.clip, instance.current.time, weight, poses.data());
+	} else {
+		sampleBindPose(skeleton, weight, poses.data());
+	}
+
+	BoneMatrix *palette = &m_palette[instance.paletteOffset];
+
+	for (size_t joint = 0; joint < jointCount; joint++) {
+
+		const JointPose &pose = poses[joint];
+		const SkeletonJoint &bind = skeleton.joints[joint];
+
+		// local = T * R * S, the uniform scale multiplies the rotation columns
+		float x = pose.rotation.x, y = pose.rotation.y, z = pose.rotation.z, w = pose.rotation.w;
+		float xx = x * x, yy = y * y, zz = z * z;
+		float xy = x * y, xz = x * z, yz = y * z;
+		float wx = w * x, wy = w * y, wz = w * z;
+		float s = pose.scale;
+
+		glm::mat4 local;
+		local[0] = glm::vec4((1.0f - 2.0f * (yy + zz)) * s, 2.0f * (xy + wz) * s, 2.0f * (xz - wy) * s, 0.0f);
+		local[1] = glm::vec4(2.0f * (xy - wz) * s, (1.0f - 2.0f * (xx + zz)) * s, 2.0f * (yz + wx) * s, 0.0f);
+		local[2] = glm::vec4(2.0f * (xz + wy) * s, 2.0f * (yz - wx) * s, (1.0f - 2.0f * (xx + yy)) * s, 0.0f);
+		local[3] = glm::vec4(pose.translation, 1.0f);
+
+		// parents come first : their global transform is already there
+		globals[joint] = bind.parent >= 0 ? globals[bind.parent] * local : local;
+
+		// rows of the transposed matrix, the shader rebuilds it with the last row (0 0 0 1)
+		glm::mat4 skin = skeleton.globalInverse * globals[joint] * bind.inverseBind;
+		BoneMatrix &out = palette[joint];
+		out.rows[0] = glm::vec4(skin[0][0], skin[1][0], skin[2][0], skin[3][0]);
+		out.rows[1] = glm::vec4(skin[0][1], skin[1][1], skin[2][1], skin[3][1]);
+		out.rows[2] = glm::vec4(skin[0][2], skin[1][2], skin[2][2], skin[3][2]);
+	}
+}
+
+void AnimationSystem::update(JobSystem &jobs, float deltaTime) {
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	// playback state is tiny, advance it here so the jobs only read it
+	for (size_t i = 0; i < m_instances.size(); i++) {
+		Instance &instance = m_instances[i];
+		instance.current.time += deltaTime * instance.current.speed;
+		// kept in range so float precision holds over long sessions
+		if (instance.current.clip && instance.current.clip->duration > 0.0f) {
+			instance.current.time = std::fmod(instance.current.time, instance.current.clip->duration);
+		}
+		if (instance.fade < instance.fadeDuration) {
+			instance.previous.time += deltaTime * instance.previous.speed;
+			instance.fade += deltaTime;
+		}
+	}
+
+	jobs.parallelFor(m_instances.size(), ANIMATION_BATCH_SIZE, [this](size_t begin, size_t end, unsigned int threadIndex) {
+		for (size_t i = begin; i < end; i++) {
+			evaluate(m_instances[i], threadIndex);
+		}
+	});
+
+	m_stats.joints = m_palette.size();
+	m_stats.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
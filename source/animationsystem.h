@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "jobsystem.h"
+#include "shaderdata.h"
+#include "skeleton.h"
+
+typedef unsigned int AnimationHandle;
+
+// Instances per parallelFor batch : a pose is a few hundred matrices, small batches balance well
+const size_t ANIMATION_BATCH_SIZE = 8;
+
+struct AnimationStats {
+	size_t instances = 0;
+	size_t joints = 0;         // evaluated by the last update, every instance included
+	float milliseconds = 0.0f; // last update
+};
+
+/**
+ * Skeletal animation of many instances.
+ * Each instance plays one clip and can crossfade from the previous one. update() spreads the instances over
+ * the workers : every worker samples and blends the local poses in its own scratch arrays, walks the hierarchy
+ * (parents come first) and writes the skinning matrices into one palette shared by all instances.
+ * The renderer uploads the palette as a storage buffer at BONE_PALETTE_BINDING, the vertex shader finds
+ * an instance's matrices at ObjectData::boneOffset.
+ **/
+class AnimationSystem {
+
+	private:
+		struct Playback {
+			const AnimationClip *clip = nullptr;
+			float time = 0.0f;
+			float speed = 1.0f;
+		};
+
+		struct Instance {
+			const Skeleton *skeleton;  // owned by the model, must outlive the instance
+			Playback current;
+			Playback previous;         // faded out over fadeDuration
+			float fade;                // seconds since play()
+			float fadeDuration;
+			unsigned int paletteOffset;
+		};
+
+		std::vector<Instance> m_instances;
+		std::vector<BoneMatrix> m_palette;
+
+		// per thread scratch
+		std::vector<std::vector<JointPose>> m_poses;
+		std::vector<std::vector<glm::mat4>> m_globals;
+
+		AnimationStats m_stats;
+
+		void evaluate(const Instance &instance, unsigned int threadIndex);
+
+	public:
+		explicit AnimationSystem(JobSystem &jobs);
+
+		AnimationSystem(const AnimationSystem &) = delete;
+		AnimationSystem &operator=(const AnimationSystem &) = delete;
+
+		// starts in the bind pose
+		AnimationHandle create(const Skeleton &skeleton);
+
+		// clip must be imported with the instance's skeleton, nullptr goes back to the bind pose
+		void play(AnimationHandle handle, const AnimationClip *clip, float fadeSeconds = 0.25f, float speed = 1.0f);
+
+		void setSpeed(AnimationHandle handle, float speed);
+
+		// advance every instance by deltaTime and rebuild the palette, spread across the workers
+		void update(JobSystem &jobs, float deltaTime);
+
+		// every instance, in creation order : copied as is into the frame packet
+		inline const std::vector<BoneMatrix> &getPalette() const {
+			return m_palette;
+		}
+
+		// for ObjectData::boneOffset
+		inline int getPaletteOffset(AnimationHandle handle) const {
+			return (int)m_instances[handle].paletteOffset;
+		}
+
+		inline size_t size() const {
+			return m_instances.size();
+		}
+
+		inline const AnimationStats &getStats() const {
+			return m_stats;
+		}
+
+};
@@ -0,0 +1,697 @@
+#include "glcapture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <sstream>
+#include <type_traits>
+#include <vector>
+
+#include <glad\glad.h>
+
+/**
+ * File layout :
+ *   "GGBC" u32 version, u32 function count
+ *   per function : u8 name length, name, u8 argument count, one type char per argument, u8 payload components
+ *   per call     : u16 function, varint start ns, varint duration ns, arguments, [varint size, payload]
+ *   end          : u16 0xFFFF, varint frame ns
+ * Arguments : 'f' raw float, 'd' raw double, 'i' zigzag varint, 'u' and 'p' varint.
+ * Uniform arrays carry their values as payload so identical writes can be detected.
+ **/
+const char CAPTURE_MAGIC[4] = { 'G', 'G', 'B', 'C' };
+const uint32_t CAPTURE_VERSION = 1;
+const uint16_t CAPTURE_END = 0xFFFF;
+
+// every GL call the renderer makes : (function, floats per element of its uniform payload)
+#define GL_CAPTURE_FUNCTIONS(X) \
+	X(glActiveTexture, 0) \
+	X(glAttachShader, 0) \
+	X(glBeginQuery, 0) \
+	X(glBindBuffer, 0) \
+	X(glBindBufferBase, 0) \
+	X(glBindBufferRange, 0) \
+	X(glBindFramebuffer, 0) \
+	X(glBindRenderbuffer, 0) \
+	X(glBindTexture, 0) \
+	X(glBindTextureUnit, 0) \
+	X(glBindVertexArray, 0) \
+	X(glBlendFunc, 0) \
+	X(glBufferData, 0) \
+	X(glBufferSubData, 0) \
+	X(glCheckFramebufferStatus, 0) \
+	X(glClear, 0) \
+	X(glClearColor, 0) \
+	X(glClientWaitSync, 0) \
+	X(glCompileShader, 0) \
+	X(glCopyImageSubData, 0) \
+	X(glCreateBuffers, 0) \
+	X(glCreateProgram, 0) \
+	X(glCreateShader, 0) \
+	X(glCreateTextures, 0) \
+	X(glDeleteBuffers, 0) \
+	X(glDeleteFramebuffers, 0) \
+	X(glDeleteProgram, 0) \
+	X(glDeleteQueries, 0) \
+	X(glDeleteRenderbuffers, 0) \
+	X(glDeleteShader, 0) \
+	X(glDeleteSync, 0) \
+	X(glDeleteTextures, 0) \
+	X(glDeleteVertexArrays, 0) \
+	X(glDepthMask, 0) \
+	X(glDisable, 0) \
+	X(glDrawArrays, 0) \
+	X(glDrawArraysInstanced, 0) \
+	X(glDrawElements, 0) \
+	X(glDrawElementsInstanced, 0) \
+	X(glEnable, 0) \
+	X(glEnableVertexAttribArray, 0) \
+	X(glEndQuery, 0) \
+	X(glFenceSync, 0) \
+	X(glFramebufferRenderbuffer, 0) \
+	X(glFramebufferTexture2D, 0) \
+	X(glGenBuffers, 0) \
+	X(glGenFramebuffers, 0) \
+	X(glGenQueries, 0) \
+	X(glGenRenderbuffers, 0) \
+	X(glGenTextures, 0) \
+	X(glGenVertexArrays, 0) \
+	X(glGenerateMipmap, 0) \
+	X(glGenerateTextureMipmap, 0) \
+	X(glGetIntegerv, 0) \
+	X(glGetProgramInfoLog, 0) \
+	X(glGetProgramiv, 0) \
+	X(glGetQueryObjectiv, 0) \
+	X(glGetQueryObjectui64v, 0) \
+	X(glGetShaderInfoLog, 0) \
+	X(glGetShaderiv, 0) \
+	X(glGetStringi, 0) \
+	X(glGetUniformLocation, 0) \
+	X(glLinkProgram, 0) \
+	X(glMapNamedBufferRange, 0) \
+	X(glMultiDrawElementsIndirect, 0) \
+	X(glNamedBufferStorage, 0) \
+	X(glPixelStorei, 0) \
+	X(glRenderbufferStorage, 0) \
+	X(glShaderSource, 0) \
+	X(glTexImage2D, 0) \
+	X(glTexParameteri, 0) \
+	X(glTexStorage2D, 0) \
+	X(glTextureParameteri, 0) \
+	X(glTextureStorage2D, 0) \
+	X(glTextureStorage3D, 0) \
+	X(glTextureSubImage2D, 0) \
+	X(glTextureSubImage3D, 0) \
+	X(glUniform1f, 0) \
+	X(glUniform1i, 0) \
+	X(glUniform2f, 0) \
+	X(glUniform3f, 0) \
+	X(glUniform4f, 0) \
+	X(glUniform1fv, 1) \
+	X(glUniform2fv, 2) \
+	X(glUniform3fv, 3) \
+	X(glUniform4fv, 4) \
+	X(glUniformMatrix2fv, 4) \
+	X(glUniformMatrix3fv, 9) \
+	X(glUniformMatrix4fv, 16) \
+	X(glUnmapNamedBuffer, 0) \
+	X(glUseProgram, 0) \
+	X(glVertexAttribIPointer, 0) \
+	X(glVertexAttribPointer, 0) \
+	X(glViewport, 0)
+
+#ifdef _DEBUG
+
+enum GlCaptureFunction {
+#define GL_CAPTURE_ENUM(name, components) GLC_##name,
+	GL_CAPTURE_FUNCTIONS(GL_CAPTURE_ENUM)
+#undef GL_CAPTURE_ENUM
+	GLC_COUNT
+};
+
+static const char *s_names[GLC_COUNT] = {
+#define GL_CAPTURE_NAME(name, components) #name,
+	GL_CAPTURE_FUNCTIONS(GL_CAPTURE_NAME)
+#undef GL_CAPTURE_NAME
+};
+
+static const unsigned char s_components[GLC_COUNT] = {
+#define GL_CAPTURE_COMPONENTS(name, components) components,
+	GL_CAPTURE_FUNCTIONS(GL_CAPTURE_COMPONENTS)
+#undef GL_CAPTURE_COMPONENTS
+};
+
+static std::string s_signatures[GLC_COUNT];
+
+static bool s_installed = false;
+static bool s_requested = false;
+static bool s_capturing = false;
+static std::string s_path;
+static std::vector<unsigned char> s_buffer;
+static size_t s_callCount = 0;
+static std::chrono::steady_clock::time_point s_frameStart;
+
+static inline uint64_t elapsedNs() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - s_frameStart).count();
+}
+
+static inline void writeBytes(const void *data, size_t size) {
+	const unsigned char *bytes = (const unsigned char *)data;
+	s_buffer.insert(s_buffer.end(), bytes, bytes + size);
+}
+
+static inline void writeVarint(uint64_t value) {
+	while (value >= 0x80) {
+		s_buffer.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	s_buffer.push_back((unsigned char)value);
+}
+
+static inline void writeU16(uint16_t value) {
+	writeBytes(&value, sizeof(value));
+}
+
+template<typename T>
+struct ArgType {
+	static const char value = std::is_pointer<T>::value ? 'p'
+		: std::is_floating_point<T>::value ? (sizeof(T) == 4 ? 'f' : 'd')
+		: std::is_signed<T>::value ? 'i' : 'u';
+};
+
+static inline void writeArg(float value) {
+	writeBytes(&value, sizeof(value));
+}
+
+static inline void writeArg(double value) {
+	writeBytes(&value, sizeof(value));
+}
+
+template<typename T>
+static inline void writeArg(T *value) {
+	writeVarint((uint64_t)(uintptr_t)value);
+}
+
+template<typename T>
+static inline void writeArg(T value) {
+	if (std::is_signed<T>::value) {
+		int64_t signedValue = (int64_t)value;
+		writeVarint(((uint64_t)signedValue << 1) ^ (uint64_t)(signedValue >> 63));
+	} else {
+		writeVarint((uint64_t)value);
+	}
+}
+
+static inline void writeFloats(int id, GLsizei count, const GLfloat *value) {
+	size_t size = value ? (size_t)count * s_components[id] * sizeof(GLfloat) : 0;
+	writeVarint(size);
+	writeBytes(value, size);
+}
+
+// payload of the uniform array functions, nothing for the others
+template<typename... A>
+static inline void writePayload(int id, A...) {
+	if (s_components[id] > 0) {
+		writeVarint(0);
+	}
+}
+
+static inline void writePayload(int id, GLint, GLsizei count, const GLfloat *value) {
+	writeFloats(id, count, value);
+}
+
+static inline void writePayload(int id, GLint, GLsizei count, GLboolean, const GLfloat *value) {
+	writeFloats(id, count, value);
+}
+
+template<typename... A>
+static void record(int id, uint64_t start, uint64_t duration, A... args) {
+	writeU16((uint16_t)id);
+	writeVarint(start);
+	writeVarint(duration);
+	int expand[] = { 0, (writeArg(args), 0)... };
+	(void)expand;
+	writePayload(id, args...);
+	s_callCount++;
+}
+
+template<int ID, typename F>
+struct GlHook;
+
+template<int ID, typename R, typename... A>
+struct GlHook<ID, R (APIENTRYP)(A...)> {
+	typedef R (APIENTRYP Function)(A...);
+	static Function real;
+
+	static R APIENTRY call(A... args) {
+		if (!s_capturing) {
+			return real(args...);
+		}
+		uint64_t start = elapsedNs();
+		R result = real(args...);
+		record(ID, start, elapsedNs() - start, args...);
+		return result;
+	}
+
+	static std::string signature() {
+		const char types[] = { ArgType<A>::value..., 0 };
+		return types;
+	}
+};
+
+template<int ID, typename... A>
+struct GlHook<ID, void (APIENTRYP)(A...)> {
+	typedef void (APIENTRYP Function)(A...);
+	static Function real;
+
+	static void APIENTRY call(A... args) {
+		if (!s_capturing) {
+			real(args...);
+			return;
+		}
+		uint64_t start = elapsedNs();
+		real(args...);
+		record(ID, start, elapsedNs() - start, args...);
+	}
+
+	static std::string signature() {
+		const char types[] = { ArgType<A>::value..., 0 };
+		return types;
+	}
+};
+
+template<int ID, typename R, typename... A>
+typename GlHook<ID, R (APIENTRYP)(A...)>::Function GlHook<ID, R (APIENTRYP)(A...)>::real = nullptr;
+
+template<int ID, typename... A>
+typename GlHook<ID, void (APIENTRYP)(A...)>::Function GlHook<ID, void (APIENTRYP)(A...)>::real = nullptr;
+
+void GlCapture::install() {
+
+	if (s_installed) {
+		return;
+	}
+
+#define GL_CAPTURE_INSTALL(name, components) \
+	if (glad_##name) { \
+		typedef GlHook<GLC_##name, decltype(glad_##name)> Hook; \
+		Hook::real = glad_##name; \
+		glad_##name = &Hook::call; \
+		s_signatures[GLC_##name] = Hook::signature(); \
+	}
+	GL_CAPTURE_FUNCTIONS(GL_CAPTURE_INSTALL)
+#undef GL_CAPTURE_INSTALL
+
+	s_installed = true;
+}
+
+void GlCapture::requestFrame(const std::string &path) {
+	s_path = path;
+	s_requested = true;
+}
+
+bool GlCapture::isCapturing() {
+	return s_capturing;
+}
+
+void GlCapture::beginFrame() {
+
+	if (!s_installed || !s_requested) {
+		return;
+	}
+
+	s_requested = false;
+	s_capturing = true;
+	s_buffer.clear();
+	s_callCount = 0;
+	s_frameStart = std::chrono::steady_clock::now();
+}
+
+void GlCapture::endFrame() {
+
+	if (!s_capturing) {
+		return;
+	}
+
+	s_capturing = false;
+	writeU16(CAPTURE_END);
+	writeVarint(elapsedNs());
+
+	std::ofstream out(s_path, std::ios::binary);
+	if (!out) {
+		std::cout << "ERROR::GL_CAPTURE::CANNOT_WRITE " << s_path << std::endl;
+		return;
+	}
+
+	uint32_t count = GLC_COUNT;
+	out.write(CAPTURE_MAGIC, sizeof(CAPTURE_MAGIC));
+	out.write((const char *)&CAPTURE_VERSION, sizeof(CAPTURE_VERSION));
+	out.write((const char *)&count, sizeof(count));
+
+	for (int i = 0; i < GLC_COUNT; i++) {
+		unsigned char nameLength = (unsigned char)std::strlen(s_names[i]);
+		unsigned char argCount = (unsigned char)s_signatures[i].size();
+		out.put((char)nameLength);
+		out.write(s_names[i], nameLength);
+		out.put((char)argCount);
+		out.write(s_signatures[i].data(), argCount);
+		out.put((char)s_components[i]);
+	}
+
+	out.write((const char *)s_buffer.data(), s_buffer.size());
+
+	std::cout << "GL capture : " << s_callCount << " calls, " << s_buffer.size() << " bytes written to " << s_path << std::endl;
+	std::vector<unsigned char>().swap(s_buffer);
+}
+
+#endif
+
+
+// offline analysis
+
+struct CaptureFunction {
+	std::string name;
+	std::string types;
+	unsigned int components;
+};
+
+struct CaptureCall {
+	uint16_t function;
+	uint64_t start;
+	uint64_t duration;
+	std::vector<uint64_t> args; // integers as is, floats as their bits
+	std::vector<unsigned char> payload;
+};
+
+class CaptureReader {
+
+	private:
+		const std::vector<char> &m_data;
+		size_t m_position;
+
+	public:
+		explicit CaptureReader(const std::vector<char> &data) : m_data(data), m_position(0) {
+		}
+
+		inline bool read(void *out, size_t size) {
+			if (m_position + size > m_data.size()) {
+				return false;
+			}
+			std::memcpy(out, m_data.data() + m_position, size);
+			m_position += size;
+			return true;
+		}
+
+		inline bool readVarint(uint64_t &value) {
+			value = 0;
+			for (int shift = 0; shift < 64; shift += 7) {
+				unsigned char byte;
+				if (!read(&byte, 1)) {
+					return false;
+				}
+				value |= (uint64_t)(byte & 0x7F) << shift;
+				if (!(byte & 0x80)) {
+					return true;
+				}
+			}
+			return false;
+		}
+
+};
+
+static bool readCapture(const std::vector<char> &data, std::vector<CaptureFunction> &functions, std::vector<CaptureCall> &calls, uint64_t &frameNs) {
+
+	CaptureReader reader(data);
+
+	char magic[4];
+	uint32_t version, count;
+	if (!reader.read(magic, 4) || std::memcmp(magic, CAPTURE_MAGIC, 4) != 0 || !reader.read(&version, 4) || version != CAPTURE_VERSION || !reader.read(&count, 4)) {
+		return false;
+	}
+
+	functions.resize(count);
+	for (uint32_t i = 0; i < count; i++) {
+		unsigned char length, components;
+		char buffer[256];
+		if (!reader.read(&length, 1) || !reader.read(buffer, length)) {
+			return false;
+		}
+		functions[i].name.assign(buffer, length);
+		if (!reader.read(&length, 1) || !reader.read(buffer, length) || !reader.read(&components, 1)) {
+			return false;
+		}
+		functions[i].types.assign(buffer, length);
+		functions[i].components = components;
+	}
+
+	while (true) {
+		CaptureCall call;
+		if (!reader.read(&call.function, 2)) {
+			return false;
+		}
+		if (call.function == CAPTURE_END) {
+			return reader.readVarint(frameNs);
+		}
+		if (call.function >= functions.size() || !reader.readVarint(call.start) || !reader.readVarint(call.duration)) {
+			return false;
+		}
+
+		const CaptureFunction &function = functions[call.function];
+		for (size_t a = 0; a < function.types.size(); a++) {
+			uint64_t value = 0;
+			char type = function.types[a];
+			if (type == 'f') {
+				uint32_t bits;
+				if (!reader.read(&bits, 4)) {
+					return false;
+				}
+				value = bits;
+			} else if (type == 'd') {
+				if (!reader.read(&value, 8)) {
+					return false;
+				}
+			} else {
+				if (!reader.readVarint(value)) {
+					return false;
+				}
+				if (type == 'i') {
+					value = (uint64_t)((int64_t)(value >> 1) ^ -(int64_t)(value & 1));
+				}
+			}
+			call.args.push_back(value);
+		}
+
+		if (function.components > 0) {
+			uint64_t size;
+			if (!reader.readVarint(size) || size > data.size()) {
+				return false;
+			}
+			call.payload.resize((size_t)size);
+			if (size > 0 && !reader.read(call.payload.data(), (size_t)size)) {
+				return false;
+			}
+		}
+
+		calls.push_back(std::move(call));
+	}
+}
+
+static std::string hex(uint64_t value) {
+	std::ostringstream text;
+	text << "0x" << std::hex << value;
+	return text.str();
+}
+
+// last value of every piece of state the capture touched
+class CaptureState {
+
+	private:
+		std::map<std::string, std::vector<uint64_t>> m_values;
+
+	public:
+		std::set<std::string> changedSinceDraw; // kinds of state changed since the last draw
+		std::map<std::string, size_t> changesByKind;
+
+		// false when the value was already set : a redundant call
+		bool set(const std::string &kind, const std::string &slot, const std::vector<uint64_t> &value) {
+			std::map<std::string, std::vector<uint64_t>>::iterator it = m_values.find(slot);
+			if (it != m_values.end() && it->second == value) {
+				return false;
+			}
+			m_values[slot] = value;
+			changedSinceDraw.insert(kind);
+			changesByKind[kind]++;
+			return true;
+		}
+
+		uint64_t get(const std::string &slot) const {
+			std::map<std::string, std::vector<uint64_t>>::const_iterator it = m_values.find(slot);
+			return it != m_values.end() && !it->second.empty() ? it->second[0] : 0;
+		}
+
+};
+
+bool AnalyzeCapture(const std::string &path, bool verbose) {
+
+	std::ifstream in(path, std::ios::binary);
+	if (!in) {
+		std::cout << "ERROR::GL_CAPTURE::CANNOT_OPEN " << path << std::endl;
+		return false;
+	}
+	std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+	std::vector<CaptureFunction> functions;
+	std::vector<CaptureCall> calls;
+	uint64_t frameNs = 0;
+	if (!readCapture(data, functions, calls, frameNs)) {
+		std::cout << "ERROR::GL_CAPTURE::CORRUPT_FILE " << path << std::endl;
+		return false;
+	}
+
+	std::vector<size_t> callCounts(functions.size(), 0);
+	std::vector<uint64_t> callTimes(functions.size(), 0);
+	std::vector<size_t> redundantCounts(functions.size(), 0);
+	uint64_t totalGlNs = 0;
+
+	CaptureState state;
+	size_t uniformWrites = 0, redundantUniformWrites = 0, locationQueries = 0;
+	size_t draws = 0, totalDeltas = 0, maxDeltas = 0;
+	std::ostringstream drawLog;
+
+	for (size_t c = 0; c < calls.size(); c++) {
+
+		const CaptureCall &call = calls[c];
+		const std::string &name = functions[call.function].name;
+		const std::vector<uint64_t> &args = call.args;
+
+		callCounts[call.function]++;
+		callTimes[call.function] += call.duration;
+		totalGlNs += call.duration;
+
+		bool changed = true;
+		std::string program = std::to_string(state.get("program"));
+
+		if (name == "glUseProgram") {
+			changed = state.set("program", "program", args);
+		} else if (name == "glBindVertexArray") {
+			changed = state.set("vertex array", "vertex array", args);
+		} else if (name == "glActiveTexture") {
+			changed = state.set("active texture", "active texture", args);
+		} else if (name == "glBindTexture") {
+			std::string unit = std::to_string(state.get("active texture") ? state.get("active texture") - GL_TEXTURE0 : 0);
+			changed = state.set("texture", "texture unit " + unit + " " + hex(args[0]), std::vector<uint64_t>(1, args[1]));
+		} else if (name == "glBindBuffer") {
+			// the element buffer belongs to the vertex array
+			std::string slot = args[0] == GL_ELEMENT_ARRAY_BUFFER ? "element buffer of " + std::to_string(state.get("vertex array")) : "buffer " + hex(args[0]);
+			changed = state.set("buffer", slot, std::vector<uint64_t>(1, args[1]));
+		} else if (name == "glBindBufferBase" || name == "glBindBufferRange") {
+			std::vector<uint64_t> value(args.begin() + 2, args.end());
+			changed = state.set("buffer range", "buffer " + hex(args[0]) + " index " + std::to_string(args[1]), value);
+			state.set("buffer", "buffer " + hex(args[0]), std::vector<uint64_t>(1, args[2]));
+		} else if (name == "glBindFramebuffer") {
+			bool draw = args[0] != GL_READ_FRAMEBUFFER;
+			bool read = args[0] != GL_DRAW_FRAMEBUFFER;
+			std::vector<uint64_t> value(1, args[1]);
+			bool drawChanged = draw && state.set("framebuffer", "draw framebuffer", value);
+			bool readChanged = read && state.set("framebuffer", "read framebuffer", value);
+			changed = drawChanged || readChanged;
+		} else if (name == "glBindRenderbuffer") {
+			changed = state.set("renderbuffer", "renderbuffer", std::vector<uint64_t>(1, args[1]));
+		} else if (name == "glEnable" || name == "glDisable") {
+			changed = state.set("capability", "capability " + hex(args[0]), std::vector<uint64_t>(1, name == "glEnable"));
+		} else if (name == "glDepthMask" || name == "glBlendFunc" || name == "glViewport" || name == "glClearColor") {
+			changed = state.set(name.substr(2), name, args);
+		} else if (name == "glPixelStorei") {
+			changed = state.set("pixel store", "pixel store " + hex(args[0]), std::vector<uint64_t>(1, args[1]));
+		} else if (name.compare(0, 9, "glUniform") == 0) {
+			// location first, then the values or the payload
+			std::vector<uint64_t> value(args.begin() + 1, args.end());
+			if (!call.payload.empty()) {
+				value.resize(1);
+				for (size_t b = 0; b < call.payload.size(); b += 8) {
+					uint64_t word = 0;
+					std::memcpy(&word, call.payload.data() + b, std::min((size_t)8, call.payload.size() - b));
+					value.push_back(word);
+				}
+			}
+			uniformWrites++;
+			changed = state.set("uniform", "uniform " + program + " " + std::to_string((int64_t)args[0]), value);
+			if (!changed) {
+				redundantUniformWrites++;
+			}
+		} else if (name == "glGetUniformLocation") {
+			locationQueries++;
+		}
+
+		if (!changed) {
+			redundantCounts[call.function]++;
+		}
+
+		if (name.compare(0, 6, "glDraw") == 0 || name.compare(0, 11, "glMultiDraw") == 0) {
+			size_t deltas = state.changedSinceDraw.size();
+			if (verbose || draws < 100) {
+				drawLog << "  #" << draws << " " << name << " :";
+				if (deltas == 0) {
+					drawLog << " no change";
+				}
+				for (std::set<std::string>::const_iterator it = state.changedSinceDraw.begin(); it != state.changedSinceDraw.end(); ++it) {
+					drawLog << " " << *it << (std::next(it) != state.changedSinceDraw.end() ? "," : "");
+				}
+				drawLog << "\n";
+			}
+			totalDeltas += deltas;
+			maxDeltas = std::max(maxDeltas, deltas);
+			state.changedSinceDraw.clear();
+			draws++;
+		}
+	}
+
+	std::cout << std::fixed << std::setprecision(3);
+	std::cout << "GL capture " << path << "\n";
+	std::cout << "  " << calls.size() << " calls, frame " << frameNs / 1e6 << " ms, " << totalGlNs / 1e6 << " ms inside GL calls\n\n";
+
+	// histogram, most called first
+	std::vector<size_t> order;
+	for (size_t i = 0; i < functions.size(); i++) {
+		if (callCounts[i] > 0) {
+			order.push_back(i);
+		}
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return callCounts[a] > callCounts[b];
+	});
+
+	std::cout << "Calls" << std::setw(31) << "count" << std::setw(12) << "total ms" << std::setw(12) << "avg us" << std::setw(12) << "redundant" << "\n";
+	for (size_t i = 0; i < order.size(); i++) {
+		size_t f = order[i];
+		std::cout << "  " << std::left << std::setw(28) << functions[f].name << std::right << std::setw(8) << callCounts[f]
+			<< std::setw(12) << callTimes[f] / 1e6 << std::setw(12) << callTimes[f] / 1e3 / callCounts[f] << std::setw(12) << redundantCounts[f] << "\n";
+	}
+
+	size_t redundant = 0;
+	for (size_t i = 0; i < functions.size(); i++) {
+		redundant += redundantCounts[i];
+	}
+	std::cout << "\nRedundant calls : " << redundant << " (state already had that value)\n";
+	std::cout << "Uniforms : " << uniformWrites << " writes, " << redundantUniformWrites << " redundant, "
+		<< locationQueries << " glGetUniformLocation queries (cacheable)\n";
+
+	std::cout << "\nDraws : " << draws;
+	if (draws > 0) {
+		std::cout << ", " << (double)totalDeltas / draws << " kinds of state changed per draw on average, " << maxDeltas << " at most";
+	}
+	std::cout << "\nState changes by kind :\n";
+	for (std::map<std::string, size_t>::const_iterator it = state.changesByKind.begin(); it != state.changesByKind.end(); ++it) {
+		std::cout << "  " << std::left << std::setw(28) << it->first << std::right << std::setw(8) << it->second << "\n";
+	}
+
+	std::cout << "\nState changed before each draw" << (verbose || draws <= 100 ? "" : " (first 100, --verbose for all)") << " :\n" << drawLog.str();
+	std::cout.flush();
+	return true;
+}
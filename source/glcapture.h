@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+
+/**
+ * Single frame GL call capture, debug builds only.
+ * install() swaps the glad function pointers of every GL call the renderer makes (GL_CAPTURE_FUNCTIONS in
+ * glcapture.cpp) for wrappers that forward the call and, while a capture runs, append its arguments and CPU
+ * time to a buffer. The frame is written to a compact binary file (varint arguments, uniform array payloads)
+ * and read back offline by AnalyzeCapture.
+ **/
+class GlCapture {
+
+	public:
+		// after gladLoadGL, GL thread
+		static void install();
+
+		// capture the next whole frame into path
+		static void requestFrame(const std::string &path);
+
+		// around everything the frame does, swap included
+		static void beginFrame();
+		static void endFrame();
+
+		static bool isCapturing();
+
+};
+
+// --analyze-capture : call histogram, redundant binds and uniform writes, state changes between draws
+bool AnalyzeCapture(const std::string &path, bool verbose);
@@ -0,0 +1,122 @@
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <memory>
+
+static thread_local unsigned int currentThreadIndex = 0;
+
+JobSystem::JobSystem(unsigned int workerCount) : m_stopping(false) {
+
+	if (workerCount == 0) {
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	for (unsigned int i = 0; i < workerCount; i++) {
+		m_workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+	}
+}
+
+JobSystem::~JobSystem() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_wakeUp.notify_all();
+
+	for (size_t i = 0; i < m_workers.size(); i++) {
+		m_workers[i].join();
+	}
+}
+
+unsigned int JobSystem::getThreadIndex() {
+	return currentThreadIndex;
+}
+
+void JobSystem::workerLoop(unsigned int threadIndex) {
+
+	currentThreadIndex = threadIndex;
+
+	while (true) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeUp.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+
+			// finish queued work before leaving so nobody waits forever on a parallelFor
+			if (m_tasks.empty()) {
+				return;
+			}
+
+			task = std::move(m_tasks.front());
+			m_tasks.pop_front();
+		}
+		task();
+	}
+}
+
+void JobSystem::submit(std::function<void()> task) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push_back(std::move(task));
+	}
+	m_wakeUp.notify_one();
+}
+
+void JobSystem::parallelFor(size_t count, size_t batchSize, const std::function<void(size_t, size_t, unsigned int)> &func) {
+
+	if (count == 0) {
+		return;
+	}
+
+	batchSize = std::max<size_t>(batchSize, 1);
+	size_t batchCount = (count + batchSize - 1) / batchSize;
+
+	// not worth waking anybody up
+	if (batchCount == 1 || m_workers.empty()) {
+		func(0, count, currentThreadIndex);
+		return;
+	}
+
+	// helpers may still be dequeued after we returned, so the shared state must outlive this call
+	struct Batches {
+		std::atomic<size_t> next;
+		std::atomic<size_t> done;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	std::shared_ptr<Batches> batches = std::make_shared<Batches>();
+	batches->next = 0;
+	batches->done = 0;
+
+	// func is only referenced while batches remain, i.e. while the caller is still blocked below
+	const std::function<void(size_t, size_t, unsigned int)> *work = &func;
+
+	auto runBatches = [batches, work, count, batchSize, batchCount]() {
+		size_t batch;
+		while ((batch = batches->next.fetch_add(1)) < batchCount) {
+			size_t begin = batch * batchSize;
+			size_t end = std::min(begin + batchSize, count);
+			(*work)(begin, end, currentThreadIndex);
+
+			if (batches->done.fetch_add(1) + 1 == batchCount) {
+				std::lock_guard<std::mutex> lock(batches->mutex);
+				batches->finished.notify_all();
+			}
+		}
+	};
+
+	size_t helpers = std::min(batchCount - 1, m_workers.size());
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (size_t i = 0; i < helpers; i++) {
+			m_tasks.push_back(runBatches);
+		}
+	}
+	m_wakeUp.notify_all();
+
+	runBatches();
+
+	std::unique_lock<std::mutex> lock(batches->mutex);
+	batches->finished.wait(lock, [&batches, batchCount] { return batches->done.load() == batchCount; });
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed pool of worker threads.
+ * parallelFor splits a range in batches, the calling thread works on it too and returns once every batch is done.
+ * submit queues a background task and returns immediately.
+ **/
+class JobSystem {
+
+	private:
+		std::vector<std::thread> m_workers;
+		std::deque<std::function<void()>> m_tasks;
+		std::mutex m_mutex;
+		std::condition_variable m_wakeUp;
+		bool m_stopping;
+
+		void workerLoop(unsigned int threadIndex);
+
+	public:
+		// workerCount = 0 picks one worker per hardware thread, minus the calling thread
+		explicit JobSystem(unsigned int workerCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem &) = delete;
+		JobSystem &operator=(const JobSystem &) = delete;
+
+		// func(begin, end, threadIndex) is called for every batch of [0, count)
+		// threadIndex is in [0, getThreadCount()) and can be used to index per thread storage
+		void parallelFor(size_t count, size_t batchSize, const std::function<void(size_t, size_t, unsigned int)> &func);
+
+		void submit(std::function<void()> task);
+
+		// workers + the thread calling parallelFor
+		inline unsigned int getThreadCount() const {
+			return (unsigned int)m_workers.size() + 1;
+		}
+
+		// index of the calling thread : 0 for any thread that is not a worker
+		static unsigned int getThreadIndex();
+
+};
@@ -0,0 +1,881 @@
+#include "lightmapbaker.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <random>
+
+#include "model.h"
+#include "memorytracker.h"
+
+const float PI = 3.14159265f;
+const int BVH_LEAF_SIZE = 4;
+const int BVH_STACK_SIZE = 64;
+
+// world space triangle, edges precomputed for the intersection
+struct BakeTriangle {
+	glm::vec3 v0;
+	glm::vec3 edge1;
+	glm::vec3 edge2;
+	glm::vec3 normal;
+};
+
+// where a triangle lives in the lightmaps, to read the direct light a bounce ray hits
+struct BakeSurface {
+	glm::vec2 uv[3];
+	unsigned int layer;
+};
+
+struct BvhNode {
+	glm::vec3 min;
+	unsigned int first;  // first triangle of a leaf, left child (right is first + 1) otherwise
+	glm::vec3 max;
+	unsigned int count;  // 0 for inner nodes
+};
+
+struct RayHit {
+	unsigned int triangle;
+	float t, u, v;
+};
+
+// median split BVH over every instance, triangles are reordered to match the leaves
+class BakeBvh {
+
+	private:
+		std::vector<BvhNode> m_nodes;
+		std::vector<BakeTriangle> m_triangles;
+		std::vector<BakeSurface> m_surfaces;
+
+		void build(unsigned int node, unsigned int first, unsigned int count, std::vector<unsigned int> &order, const std::vector<glm::vec3> &centroids, const std::vector<BakeTriangle> &triangles) {
+
+			glm::vec3 boundsMin(1e30f), boundsMax(-1e30f);
+			glm::vec3 centerMin(1e30f), centerMax(-1e30f);
+			for (unsigned int i = first; i < first + count; i++) {
+				const BakeTriangle &triangle = triangles[order[i]];
+				glm::vec3 v1 = triangle.v0 + triangle.edge1;
+				glm::vec3 v2 = triangle.v0 + triangle.edge2;
+				boundsMin = glm::min(boundsMin, glm::min(triangle.v0, glm::min(v1, v2)));
+				boundsMax = glm::max(boundsMax, glm::max(triangle.v0, glm::max(v1, v2)));
+				centerMin = glm::min(centerMin, centroids[order[i]]);
+				centerMax = glm::max(centerMax, centroids[order[i]]);
+			}
+			m_nodes[node].min = boundsMin;
+			m_nodes[node].max = boundsMax;
+
+			if (count <= BVH_LEAF_SIZE) {
+				m_nodes[node].first = first;
+				m_nodes[node].count = count;
+				return;
+			}
+
+			glm::vec3 extent = centerMax - centerMin;
+			int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+			unsigned int half = count / 2;
+			std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, [&](unsigned int a, unsigned int b) {
+				return centroids[a][axis] < centroids[b][axis];
+			});
+
+			unsigned int left = (unsigned int)m_nodes.size();
+			m_nodes.resize(m_nodes.size() + 2);
+			m_nodes[node].first = left;
+			m_nodes[node].count = 0;
+			build(left, first, half, order, centroids, triangles);
+			build(left + 1, first + half, count - half, order, centroids, triangles);
+		}
+
+		static inline bool hitBox(const BvhNode &node, const glm::vec3 &origin, const glm::vec3 &inverseDirection, float tMax) {
+			float tNear = 0.0f, tFar = tMax;
+			for (int axis = 0; axis < 3; axis++) {
+				float t0 = (node.min[axis] - origin[axis]) * inverseDirection[axis];
+				float t1 = (node.max[axis] - origin[axis]) * inverseDirection[axis];
+				tNear = std::max(tNear, std::min(t0, t1));
+				tFar = std::min(tFar, std::max(t0, t1));
+			}
+			return tNear <= tFar;
+		}
+
+	public:
+		void build(std::vector<BakeTriangle> &triangles, std::vector<BakeSurface> &surfaces) {
+
+			m_nodes.clear();
+			if (triangles.empty()) {
+				return;
+			}
+
+			std::vector<unsigned int> order(triangles.size());
+			std::vector<glm::vec3> centroids(triangles.size());
+			for (size_t i = 0; i < triangles.size(); i++) {
+				order[i] = (unsigned int)i;
+				centroids[i] = triangles[i].v0 + (triangles[i].edge1 + triangles[i].edge2) * (1.0f / 3.0f);
+			}
+
+			m_nodes.reserve(triangles.size() / BVH_LEAF_SIZE * 2 + 1);
+			m_nodes.resize(1);
+			build(0, 0, (unsigned int)triangles.size(), order, centroids, triangles);
+
+			m_triangles.resize(triangles.size());
+			m_surfaces.resize(surfaces.size());
+			for (size_t i = 0; i < order.size(); i++) {
+				m_triangles[i] = triangles[order[i]];
+				m_surfaces[i] = surfaces[order[i]];
+			}
+		}
+
+		// closest hit, or any hit when shadow is set
+		bool intersect(const glm::vec3 &origin, const glm::vec3 &direction, float tMax, bool shadow, RayHit &hit) const {
+
+			if (m_nodes.empty()) {
+				return false;
+			}
+
+			glm::vec3 inverseDirection(1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z);
+			unsigned int stack[BVH_STACK_SIZE];
+			int stackSize = 0;
+			stack[stackSize++] = 0;
+
+			bool found = false;
+			hit.t = tMax;
+
+			while (stackSize > 0) {
+				const BvhNode &node = m_nodes[stack[--stackSize]];
+				if (!hitBox(node, origin, inverseDirection, hit.t)) {
+					continue;
+				}
+
+				if (node.count == 0) {
+					stack[stackSize++] = node.first;
+					stack[stackSize++] = node.first + 1;
+					continue;
+				}
+
+				for (unsigned int i = node.first; i < node.first + node.count; i++) {
+					// Moller-Trumbore, both sides
+					const BakeTriangle &triangle = m_triangles[i];
+					glm::vec3 p = glm::cross(direction, triangle.edge2);
+					float determinant = glm::dot(triangle.edge1, p);
+					if (std::abs(determinant) < 1e-12f) {
+						continue;
+					}
+					float inverseDeterminant = 1.0f / determinant;
+					glm::vec3 s = origin - triangle.v0;
+					float u = glm::dot(s, p) * inverseDeterminant;
+					if (u < 0.0f || u > 1.0f) {
+						continue;
+					}
+					glm::vec3 q = glm::cross(s, triangle.edge1);
+					float v = glm::dot(direction, q) * inverseDeterminant;
+					if (v < 0.0f || u + v > 1.0f) {
+						continue;
+					}
+					float t = glm::dot(triangle.edge2, q) * inverseDeterminant;
+					if (t > 0.0f && t < hit.t) {
+						hit.triangle = i;
+						hit.t = t;
+						hit.u = u;
+						hit.v = v;
+						found = true;
+						if (shadow) {
+							return true;
+						}
+					}
+				}
+			}
+			return found;
+		}
+
+		inline const BakeTriangle &getTriangle(unsigned int index) const {
+			return m_triangles[index];
+		}
+
+		inline const BakeSurface &getSurface(unsigned int index) const {
+			return m_surfaces[index];
+		}
+
+};
+
+// a triangle of the atlas, in texels
+struct LayoutTriangle {
+	const Mesh *mesh;
+	unsigned int firstIndex;
+	glm::vec2 uv[3];
+};
+
+// atlas of one model : its triangles binned by tile
+struct ModelLayout {
+	std::vector<LayoutTriangle> triangles;
+	std::vector<std::vector<unsigned int>> tiles;
+};
+
+// what a texel sees of its triangle
+struct TexelSample {
+	int triangle; // -1 outside every chart
+	float b1, b2; // barycentric weights of the second and third vertex
+};
+
+LightmapBaker::LightmapBaker() : m_enabled(false), m_texture(0), m_baking(false), m_baked(false), m_bakedLayers(0), m_cancel(false) {
+}
+
+LightmapBaker &LightmapBaker::get() {
+	static LightmapBaker instance;
+	return instance;
+}
+
+void LightmapBaker::enable(LightmapSettings settings) {
+	m_settings = settings;
+	m_enabled = true;
+}
+
+void LightmapBaker::buildCharts(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<LightmapChart> &charts) const {
+
+	charts.clear();
+
+	size_t triangleCount = indices.size() / 3;
+	indices.resize(triangleCount * 3);
+	if (triangleCount == 0) {
+		return;
+	}
+
+	std::vector<glm::vec3> normals(triangleCount);
+	for (size_t t = 0; t < triangleCount; t++) {
+		const glm::vec3 &a = vertices[indices[t * 3]].position;
+		glm::vec3 normal = glm::cross(vertices[indices[t * 3 + 1]].position - a, vertices[indices[t * 3 + 2]].position - a);
+		float length = glm::length(normal);
+		normals[t] = length > 0.0f ? normal / length : glm::vec3(0.0f);
+	}
+
+	// vertex to triangles adjacency
+	std::vector<unsigned int> adjacencyOffsets(vertices.size() + 1, 0);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacencyOffsets[indices[i] + 1]++;
+	}
+	for (size_t v = 0; v < vertices.size(); v++) {
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+	std::vector<unsigned int> adjacency(indices.size());
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	float cosLimit = std::cos(glm::radians(m_settings.chartAngle));
+
+	std::vector<char> assigned(triangleCount, 0);
+	std::vector<int> remap(vertices.size(), -1);
+	std::vector<unsigned int> chartTriangles, stack, touched;
+	std::vector<Vertex> chartVertices;
+	chartVertices.reserve(vertices.size());
+
+	for (size_t seed = 0; seed < triangleCount; seed++) {
+
+		if (assigned[seed]) {
+			continue;
+		}
+
+		glm::vec3 chartNormal = glm::length(normals[seed]) > 0.0f ? normals[seed] : glm::vec3(0.0f, 0.0f, 1.0f);
+
+		// flood through shared vertices while the normals stay close to the seed's
+		chartTriangles.clear();
+		stack.clear();
+		stack.push_back((unsigned int)seed);
+		assigned[seed] = 1;
+		while (!stack.empty()) {
+			unsigned int triangle = stack.back();
+			stack.pop_back();
+			chartTriangles.push_back(triangle);
+			for (int corner = 0; corner < 3; corner++) {
+				unsigned int vertex = indices[triangle * 3 + corner];
+				for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+					unsigned int neighbour = adjacency[a];
+					if (!assigned[neighbour] && glm::dot(normals[neighbour], chartNormal) >= cosLimit) {
+						assigned[neighbour] = 1;
+						stack.push_back(neighbour);
+					}
+				}
+			}
+		}
+
+		// planar projection along the chart normal
+		glm::vec3 up = std::abs(chartNormal.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::vec3 tangent = glm::normalize(glm::cross(up, chartNormal));
+		glm::vec3 bitangent = glm::cross(chartNormal, tangent);
+
+		LightmapChart chart;
+		chart.firstVertex = (unsigned int)chartVertices.size();
+		chart.min = glm::vec2(1e30f);
+		chart.max = glm::vec2(-1e30f);
+
+		touched.clear();
+		for (size_t i = 0; i < chartTriangles.size(); i++) {
+			for (int corner = 0; corner < 3; corner++) {
+				unsigned int &index = indices[chartTriangles[i] * 3 + corner];
+				if (remap[index] < 0) {
+					remap[index] = (int)chartVertices.size();
+					touched.push_back(index);
+					Vertex vertex = vertices[index];
+					vertex.lightmapCoords = glm::vec2(glm::dot(vertex.position, tangent), glm::dot(vertex.position, bitangent));
+					chart.min = glm::min(chart.min, vertex.lightmapCoords);
+					chart.max = glm::max(chart.max, vertex.lightmapCoords);
+					chartVertices.push_back(vertex);
+				}
+				index = (unsigned int)remap[index];
+			}
+		}
+		for (size_t i = 0; i < touched.size(); i++) {
+			remap[touched[i]] = -1;
+		}
+
+		chart.vertexCount = (unsigned int)chartVertices.size() - chart.firstVertex;
+		charts.push_back(chart);
+	}
+
+	vertices.swap(chartVertices);
+}
+
+bool LightmapBaker::packCharts(std::vector<MeshData> &meshes) const {
+
+	struct ChartRef {
+		MeshData *mesh;
+		const LightmapChart *chart;
+		int width, height;  // texels, padding included
+		int x, y;
+	};
+
+	std::vector<ChartRef> refs;
+	float area = 0.0f;
+	for (size_t m = 0; m < meshes.size(); m++) {
+		for (size_t c = 0; c < meshes[m].charts.size(); c++) {
+			ChartRef ref;
+			ref.mesh = &meshes[m];
+			ref.chart = &meshes[m].charts[c];
+			refs.push_back(ref);
+			glm::vec2 size = ref.chart->max - ref.chart->min;
+			area += size.x * size.y;
+		}
+	}
+
+	if (refs.empty()) {
+		return true;
+	}
+
+	// tallest first on shelves
+	std::sort(refs.begin(), refs.end(), [](const ChartRef &a, const ChartRef &b) {
+		return a.chart->max.y - a.chart->min.y > b.chart->max.y - b.chart->min.y;
+	});
+
+	int atlasSize = m_settings.atlasSize;
+	int padding = m_settings.padding;
+	// aim at half the atlas, shelves and padding waste the rest
+	float texelsPerUnit = area > 0.0f ? atlasSize * std::sqrt(0.5f / area) : (float)atlasSize;
+
+	bool packed = false;
+	for (int attempt = 0; attempt < 64 && !packed; attempt++) {
+
+		int x = 0, y = 0, shelfHeight = 0;
+		packed = true;
+		for (size_t i = 0; i < refs.size() && packed; i++) {
+			ChartRef &ref = refs[i];
+			glm::vec2 size = (ref.chart->max - ref.chart->min) * texelsPerUnit;
+			ref.width = (int)std::ceil(size.x) + 1 + 2 * padding;
+			ref.height = (int)std::ceil(size.y) + 1 + 2 * padding;
+			if (x + ref.width > atlasSize) {
+				x = 0;
+				y += shelfHeight;
+				shelfHeight = 0;
+			}
+			ref.x = x;
+			ref.y = y;
+			x += ref.width;
+			shelfHeight = std::max(shelfHeight, ref.height);
+			packed = ref.width <= atlasSize && y + ref.height <= atlasSize;
+		}
+
+		if (!packed) {
+			texelsPerUnit *= 0.9f;
+		}
+	}
+
+	if (!packed) {
+		std::cout << "ERROR::LIGHTMAP::ATLAS_TOO_SMALL " << refs.size() << " charts" << std::endl;
+		return false;
+	}
+
+	for (size_t i = 0; i < refs.size(); i++) {
+		const ChartRef &ref = refs[i];
+		glm::vec2 origin((float)(ref.x + padding), (float)(ref.y + padding));
+		for (unsigned int v = ref.chart->firstVertex; v < ref.chart->firstVertex + ref.chart->vertexCount; v++) {
+			glm::vec2 &coords = ref.mesh->vertices[v].lightmapCoords;
+			coords = (origin + glm::vec2(0.5f) + (coords - ref.chart->min) * texelsPerUnit) / (float)atlasSize;
+		}
+	}
+
+	// only the packing needed them
+	for (size_t m = 0; m < meshes.size(); m++) {
+		std::vector<LightmapChart>().swap(meshes[m].charts);
+	}
+	return true;
+}
+
+static void buildLayout(const std::vector<Mesh> &meshes, int atlasSize, int tileSize, ModelLayout &layout) {
+
+	int tilesPerSide = (atlasSize + tileSize - 1) / tileSize;
+	layout.tiles.resize(tilesPerSide * tilesPerSide);
+
+	for (size_t m = 0; m < meshes.size(); m++) {
+		const Mesh &mesh = meshes[m];
+		// skinned meshes move : lit live, not baked
+		if (mesh.skinned) {
+			continue;
+		}
+		for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+
+			LayoutTriangle triangle;
+			triangle.mesh = &mesh;
+			triangle.firstIndex = (unsigned int)i;
+			glm::vec2 uvMin(1e30f), uvMax(-1e30f);
+			for (int corner = 0; corner < 3; corner++) {
+				triangle.uv[corner] = mesh.vertices[mesh.indices[i + corner]].lightmapCoords * (float)atlasSize;
+				uvMin = glm::min(uvMin, triangle.uv[corner]);
+				uvMax = glm::max(uvMax, triangle.uv[corner]);
+			}
+
+			unsigned int index = (unsigned int)layout.triangles.size();
+			layout.triangles.push_back(triangle);
+
+			int tileMinX = std::max(0, (int)std::floor(uvMin.x) / tileSize);
+			int tileMinY = std::max(0, (int)std::floor(uvMin.y) / tileSize);
+			int tileMaxX = std::min(tilesPerSide - 1, (int)std::floor(uvMax.x) / tileSize);
+			int tileMaxY = std::min(tilesPerSide - 1, (int)std::floor(uvMax.y) / tileSize);
+			for (int y = tileMinY; y <= tileMaxY; y++) {
+				for (int x = tileMinX; x <= tileMaxX; x++) {
+					layout.tiles[y * tilesPerSide + x].push_back(index);
+				}
+			}
+		}
+	}
+}
+
+// the triangle under the center of every texel of a tile
+static void rasterizeTile(const ModelLayout &layout, int tile, int tilesPerSide, int tileSize, int atlasSize, std::vector<TexelSample> &samples) {
+
+	int originX = (tile % tilesPerSide) * tileSize;
+	int originY = (tile / tilesPerSide) * tileSize;
+
+	TexelSample empty;
+	empty.triangle = -1;
+	empty.b1 = empty.b2 = 0.0f;
+	samples.assign(tileSize * tileSize, empty);
+
+	const std::vector<unsigned int> &triangles = layout.tiles[tile];
+	for (size_t i = 0; i < triangles.size(); i++) {
+
+		const LayoutTriangle &triangle = layout.triangles[triangles[i]];
+		glm::vec2 e1 = triangle.uv[1] - triangle.uv[0];
+		glm::vec2 e2 = triangle.uv[2] - triangle.uv[0];
+		float area = e1.x * e2.y - e1.y * e2.x;
+		if (std::abs(area) < 1e-12f) {
+			continue;
+		}
+
+		int minX = std::max(originX, (int)std::floor(std::min(triangle.uv[0].x, std::min(triangle.uv[1].x, triangle.uv[2].x))));
+		int minY = std::max(originY, (int)std::floor(std::min(triangle.uv[0].y, std::min(triangle.uv[1].y, triangle.uv[2].y))));
+		int maxX = std::min(std::min(originX + tileSize, atlasSize) - 1, (int)std::floor(std::max(triangle.uv[0].x, std::max(triangle.uv[1].x, triangle.uv[2].x))));
+		int maxY = std::min(std::min(originY + tileSize, atlasSize) - 1, (int)std::floor(std::max(triangle.uv[0].y, std::max(triangle.uv[1].y, triangle.uv[2].y))));
+
+		for (int y = minY; y <= maxY; y++) {
+			for (int x = minX; x <= maxX; x++) {
+				TexelSample &sample = samples[(y - originY) * tileSize + (x - originX)];
+				if (sample.triangle >= 0) {
+					continue;
+				}
+				glm::vec2 p = glm::vec2(x + 0.5f, y + 0.5f) - triangle.uv[0];
+				float b1 = (p.x * e2.y - p.y * e2.x) / area;
+				float b2 = (e1.x * p.y - e1.y * p.x) / area;
+				if (b1 >= -1e-4f && b2 >= -1e-4f && b1 + b2 <= 1.0f + 1e-4f) {
+					sample.triangle = (int)triangles[i];
+					sample.b1 = b1;
+					sample.b2 = b2;
+				}
+			}
+		}
+	}
+}
+
+// unshadowed ambient terms, as the shader adds them
+static glm::vec3 ambientLight(const LightData &lights, const glm::vec3 &position) {
+	glm::vec3 result = lights.dirLight.ambient;
+	for (int i = 0; i < NR_POINT_LIGHTS; i++) {
+		const PointLightData &light = lights.pointLights[i];
+		float distance = glm::length(light.position - position);
+		result += light.ambient / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+	}
+	return result;
+}
+
+// diffuse irradiance of the static lights, with shadow rays
+static glm::vec3 directLight(const LightData &lights, const BakeBvh &bvh, const glm::vec3 &position, const glm::vec3 &normal, float bias, size_t &rays) {
+
+	glm::vec3 result(0.0f);
+	glm::vec3 origin = position + normal * bias;
+	RayHit hit;
+
+	glm::vec3 toSun = -glm::normalize(lights.dirLight.direction);
+	float sunCosine = glm::dot(normal, toSun);
+	if (sunCosine > 0.0f) {
+		rays++;
+		if (!bvh.intersect(origin, toSun, 1e30f, true, hit)) {
+			result += lights.dirLight.diffuse * sunCosine;
+		}
+	}
+
+	for (int i = 0; i < NR_POINT_LIGHTS; i++) {
+		const PointLightData &light = lights.pointLights[i];
+		glm::vec3 toLight = light.position - origin;
+		float distance = glm::length(toLight);
+		if (distance <= bias) {
+			continue;
+		}
+		toLight /= distance;
+		float cosine = glm::dot(normal, toLight);
+		if (cosine <= 0.0f) {
+			continue;
+		}
+		rays++;
+		if (!bvh.intersect(origin, toLight, distance - bias, true, hit)) {
+			result += light.diffuse * cosine / (light.constant + light.linear * distance + light.quadratic * distance * distance);
+		}
+	}
+	return result;
+}
+
+// fills the texels outside the charts from their covered neighbours, so bilinear taps at chart borders stay lit
+static void dilate(std::vector<glm::vec3> &texels, std::vector<char> &covered, int size, int iterations) {
+	for (int iteration = 0; iteration < iterations; iteration++) {
+		std::vector<char> next = covered;
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				if (covered[y * size + x]) {
+					continue;
+				}
+				glm::vec3 sum(0.0f);
+				int count = 0;
+				for (int dy = -1; dy <= 1; dy++) {
+					for (int dx = -1; dx <= 1; dx++) {
+						int nx = x + dx, ny = y + dy;
+						if (nx >= 0 && ny >= 0 && nx < size && ny < size && covered[ny * size + nx]) {
+							sum += texels[ny * size + nx];
+							count++;
+						}
+					}
+				}
+				if (count > 0) {
+					texels[y * size + x] = sum / (float)count;
+					next[y * size + x] = 1;
+				}
+			}
+		}
+		covered.swap(next);
+	}
+}
+
+bool LightmapBaker::bake(JobSystem &jobs, const std::vector<LightmapInstance> &instances, const LightData &lights) {
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_baking) {
+			return false;
+		}
+		m_baking = true;
+	}
+	m_cancel = false;
+
+	// copies : the job outlives the caller's arrays
+	JobSystem *jobSystem = &jobs;
+	jobs.submit([this, jobSystem, instances, lights]() {
+
+		std::vector<glm::vec3> texels;
+		LightmapStats stats;
+		bool success = trace(*jobSystem, instances, lights, texels, stats);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (success) {
+			m_bakedTexels.swap(texels);
+			m_bakedLayers = (int)instances.size();
+			m_bakedStats = stats;
+			m_baked = true;
+		}
+		m_baking = false;
+		m_bakeDone.notify_all();
+	});
+
+	return true;
+}
+
+bool LightmapBaker::trace(JobSystem &jobs, const std::vector<LightmapInstance> &instances, const LightData &lights, std::vector<glm::vec3> &texels, LightmapStats &stats) const {
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	if (instances.empty()) {
+		return false;
+	}
+
+	int atlasSize = m_settings.atlasSize;
+	int tileSize = m_settings.tileSize;
+	int tilesPerSide = (atlasSize + tileSize - 1) / tileSize;
+	int tilesPerLayer = tilesPerSide * tilesPerSide;
+	size_t texelsPerLayer = (size_t)atlasSize * atlasSize;
+	float bias = m_settings.rayBias;
+
+	// atlases, shared by the instances of a model
+	std::map<const std::vector<Mesh> *, ModelLayout> layouts;
+	for (size_t i = 0; i < instances.size(); i++) {
+		if (layouts.find(instances[i].meshes) == layouts.end()) {
+			buildLayout(*instances[i].meshes, atlasSize, tileSize, layouts[instances[i].meshes]);
+		}
+	}
+
+	// every instance in world space
+	std::vector<BakeTriangle> triangles;
+	std::vector<BakeSurface> surfaces;
+	for (size_t i = 0; i < instances.size(); i++) {
+		const glm::mat4 &world = instances[i].world;
+		const std::vector<Mesh> &meshes = *instances[i].meshes;
+		for (size_t m = 0; m < meshes.size(); m++) {
+			const Mesh &mesh = meshes[m];
+			// nor do they cast baked shadows, they are not where the bind pose puts them
+			if (mesh.skinned) {
+				continue;
+			}
+			for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3) {
+				glm::vec3 p[3];
+				BakeSurface surface;
+				surface.layer = (unsigned int)i;
+				for (int corner = 0; corner < 3; corner++) {
+					const Vertex &vertex = mesh.vertices[mesh.indices[t + corner]];
+					p[corner] = glm::vec3(world * glm::vec4(vertex.position, 1.0f));
+					surface.uv[corner] = vertex.lightmapCoords;
+				}
+				BakeTriangle triangle;
+				triangle.v0 = p[0];
+				triangle.edge1 = p[1] - p[0];
+				triangle.edge2 = p[2] - p[0];
+				glm::vec3 normal = glm::cross(triangle.edge1, triangle.edge2);
+				float length = glm::length(normal);
+				triangle.normal = length > 0.0f ? normal / length : glm::vec3(0.0f);
+				triangles.push_back(triangle);
+				surfaces.push_back(surface);
+			}
+		}
+	}
+	stats.triangles = triangles.size();
+
+	// only skinned meshes : nothing to bake
+	if (triangles.empty()) {
+		return false;
+	}
+
+	BakeBvh bvh;
+	bvh.build(triangles, surfaces);
+	std::vector<BakeTriangle>().swap(triangles);
+	std::vector<BakeSurface>().swap(surfaces);
+
+	std::vector<glm::vec3> direct(texelsPerLayer * instances.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> result(texelsPerLayer * instances.size(), glm::vec3(0.0f));
+	std::vector<char> covered(texelsPerLayer * instances.size(), 0);
+	std::vector<std::vector<TexelSample>> samples(jobs.getThreadCount()); // per thread
+	std::atomic<size_t> rays(0);
+
+	// world space position, shading and geometric normals of a texel
+	auto surfacePoint = [&](const LightmapInstance &instance, const glm::mat3 &normalMatrix, const ModelLayout &layout, const TexelSample &sample, glm::vec3 &position, glm::vec3 &normal) {
+		const LayoutTriangle &triangle = layout.triangles[sample.triangle];
+		const Vertex &a = triangle.mesh->vertices[triangle.mesh->indices[triangle.firstIndex]];
+		const Vertex &b = triangle.mesh->vertices[triangle.mesh->indices[triangle.firstIndex + 1]];
+		const Vertex &c = triangle.mesh->vertices[triangle.mesh->indices[triangle.firstIndex + 2]];
+		float b0 = 1.0f - sample.b1 - sample.b2;
+		position = glm::vec3(instance.world * glm::vec4(a.position * b0 + b.position * sample.b1 + c.position * sample.b2, 1.0f));
+		normal = normalMatrix * (a.normals * b0 + b.normals * sample.b1 + c.normals * sample.b2);
+		float length = glm::length(normal);
+		normal = length > 0.0f ? normal / length : glm::vec3(0.0f, 1.0f, 0.0f);
+	};
+
+	// tile jobs : (layer, tile) pairs, pulled by the workers in order
+	size_t jobCount = (size_t)tilesPerLayer * instances.size();
+
+	// direct light
+	jobs.parallelFor(jobCount, 1, [&](size_t begin, size_t end, unsigned int thread) {
+		size_t localRays = 0;
+		for (size_t job = begin; job < end && !m_cancel; job++) {
+			size_t layer = job / tilesPerLayer;
+			int tile = (int)(job % tilesPerLayer);
+			const LightmapInstance &instance = instances[layer];
+			const ModelLayout &layout = layouts.find(instance.meshes)->second;
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance.world)));
+
+			rasterizeTile(layout, tile, tilesPerSide, tileSize, atlasSize, samples[thread]);
+			for (int t = 0; t < tileSize * tileSize; t++) {
+				const TexelSample &sample = samples[thread][t];
+				int x = (tile % tilesPerSide) * tileSize + t % tileSize;
+				int y = (tile / tilesPerSide) * tileSize + t / tileSize;
+				if (sample.triangle < 0 || x >= atlasSize || y >= atlasSize) {
+					continue;
+				}
+				glm::vec3 position, normal;
+				surfacePoint(instance, normalMatrix, layout, sample, position, normal);
+				size_t texel = layer * texelsPerLayer + (size_t)y * atlasSize + x;
+				direct[texel] = directLight(lights, bvh, position, normal, bias, localRays);
+				covered[texel] = 1;
+			}
+		}
+		rays += localRays;
+	});
+
+	if (m_cancel) {
+		return false;
+	}
+
+	// the bounce reads direct light at the hit : seams must not read black
+	for (size_t layer = 0; layer < instances.size(); layer++) {
+		std::vector<glm::vec3> texels(direct.begin() + layer * texelsPerLayer, direct.begin() + (layer + 1) * texelsPerLayer);
+		std::vector<char> mask(covered.begin() + layer * texelsPerLayer, covered.begin() + (layer + 1) * texelsPerLayer);
+		dilate(texels, mask, atlasSize, m_settings.padding);
+		std::copy(texels.begin(), texels.end(), direct.begin() + layer * texelsPerLayer);
+	}
+
+	// one bounce, cosine weighted : irradiance = albedo * mean of the irradiance at the hits
+	jobs.parallelFor(jobCount, 1, [&](size_t begin, size_t end, unsigned int thread) {
+		size_t localRays = 0;
+		for (size_t job = begin; job < end && !m_cancel; job++) {
+			size_t layer = job / tilesPerLayer;
+			int tile = (int)(job % tilesPerLayer);
+			const LightmapInstance &instance = instances[layer];
+			const ModelLayout &layout = layouts.find(instance.meshes)->second;
+			glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(instance.world)));
+
+			rasterizeTile(layout, tile, tilesPerSide, tileSize, atlasSize, samples[thread]);
+			for (int t = 0; t < tileSize * tileSize; t++) {
+				const TexelSample &sample = samples[thread][t];
+				int x = (tile % tilesPerSide) * tileSize + t % tileSize;
+				int y = (tile / tilesPerSide) * tileSize + t / tileSize;
+				if (sample.triangle < 0 || x >= atlasSize || y >= atlasSize) {
+					continue;
+				}
+				glm::vec3 position, normal;
+				surfacePoint(instance, normalMatrix, layout, sample, position, normal);
+				size_t texel = layer * texelsPerLayer + (size_t)y * atlasSize + x;
+
+				glm::vec3 up = std::abs(normal.y) < 0.99f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+				glm::vec3 tangent = glm::normalize(glm::cross(up, normal));
+				glm::vec3 bitangent = glm::cross(normal, tangent);
+				glm::vec3 origin = position + normal * bias;
+
+				std::minstd_rand random((unsigned int)(texel * 2654435761u + 1));
+				std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
+
+				glm::vec3 gathered(0.0f);
+				for (unsigned int s = 0; s < m_settings.bounceSamples; s++) {
+					float r1 = distribution(random);
+					float r2 = distribution(random);
+					float phi = 2.0f * PI * r1;
+					float radius = std::sqrt(r2);
+					glm::vec3 direction = tangent * (radius * std::cos(phi)) + bitangent * (radius * std::sin(phi)) + normal * std::sqrt(1.0f - r2);
+
+					RayHit hit;
+					localRays++;
+					if (!bvh.intersect(origin, direction, 1e30f, false, hit)) {
+						continue;
+					}
+					// inside of a closed mesh : no light
+					if (glm::dot(bvh.getTriangle(hit.triangle).normal, direction) >= 0.0f) {
+						continue;
+					}
+					const BakeSurface &surface = bvh.getSurface(hit.triangle);
+					glm::vec2 uv = surface.uv[0] * (1.0f - hit.u - hit.v) + surface.uv[1] * hit.u + surface.uv[2] * hit.v;
+					int hitX = std::min(std::max((int)(uv.x * atlasSize), 0), atlasSize - 1);
+					int hitY = std::min(std::max((int)(uv.y * atlasSize), 0), atlasSize - 1);
+					gathered += direct[surface.layer * texelsPerLayer + (size_t)hitY * atlasSize + hitX];
+				}
+
+				glm::vec3 indirect = m_settings.bounceSamples > 0 ? gathered * (m_settings.bounceAlbedo / m_settings.bounceSamples) : glm::vec3(0.0f);
+				result[texel] = ambientLight(lights, position) + direct[texel] + indirect;
+			}
+		}
+		rays += localRays;
+	});
+
+	if (m_cancel) {
+		return false;
+	}
+
+	for (size_t i = 0; i < covered.size(); i++) {
+		stats.texels += covered[i];
+	}
+	stats.rays = rays.load();
+
+	for (size_t layer = 0; layer < instances.size(); layer++) {
+		std::vector<glm::vec3> layerTexels(result.begin() + layer * texelsPerLayer, result.begin() + (layer + 1) * texelsPerLayer);
+		std::vector<char> mask(covered.begin() + layer * texelsPerLayer, covered.begin() + (layer + 1) * texelsPerLayer);
+		dilate(layerTexels, mask, atlasSize, m_settings.padding);
+		std::copy(layerTexels.begin(), layerTexels.end(), result.begin() + layer * texelsPerLayer);
+	}
+	texels.swap(result);
+
+	stats.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	return true;
+}
+
+void LightmapBaker::update() {
+
+	std::vector<glm::vec3> texels;
+	GLsizei layers;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_baked) {
+			return;
+		}
+		m_baked = false;
+		texels.swap(m_bakedTexels);
+		layers = (GLsizei)m_bakedLayers;
+		m_stats = m_bakedStats;
+	}
+
+	// replaces an earlier bake
+	if (m_texture) {
+		MemoryTracker::get().untrackTexture(m_texture);
+		glDeleteTextures(1, &m_texture);
+	}
+
+	int atlasSize = m_settings.atlasSize;
+	glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &m_texture);
+	glTextureStorage3D(m_texture, 1, GL_R11F_G11F_B10F, atlasSize, atlasSize, layers);
+	glTextureSubImage3D(m_texture, 0, 0, 0, 0, atlasSize, atlasSize, layers, GL_RGB, GL_FLOAT, texels.data());
+	glTextureParameteri(m_texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTextureParameteri(m_texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTextureParameteri(m_texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTextureParameteri(m_texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	// layers stacked : same byte count as one tall texture
+	MemoryTracker::get().trackTexture(m_texture, atlasSize, atlasSize * layers, GL_R11F_G11F_B10F, 1, MemoryCategory::TEXTURE, "lightmaps");
+
+	std::cout << "Lightmaps baked : " << layers << " layers of " << atlasSize << "x" << atlasSize << ", " << m_stats.texels << " texels, "
+		<< m_stats.triangles << " triangles, " << m_stats.rays << " rays in " << m_stats.milliseconds << " ms" << std::endl;
+}
+
+void LightmapBaker::shutdown() {
+
+	// a running bake reads the meshes : it is over before they can go away
+	m_cancel = true;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_bakeDone.wait(lock, [this] { return !m_baking; });
+		m_baked = false;
+		std::vector<glm::vec3>().swap(m_bakedTexels);
+	}
+
+	if (m_texture) {
+		MemoryTracker::get().untrackTexture(m_texture);
+		glDeleteTextures(1, &m_texture);
+		m_texture = 0;
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include "mesh.h"
+#include "shaderdata.h"
+#include "jobsystem.h"
+
+struct MeshData;
+
+struct LightmapSettings {
+	int atlasSize = 512;              // texels per side, every mesh of a model shares the atlas
+	int padding = 2;                  // texels around each chart, keeps bilinear filtering inside it
+	float chartAngle = 45.0f;         // degrees : triangles further from the chart normal start a new chart
+	int tileSize = 32;                // texels per side of a bake job
+	unsigned int bounceSamples = 32;  // hemisphere rays per texel for the indirect bounce
+	float bounceAlbedo = 0.5f;        // reflectance of the surfaces the bounce rays hit
+	float rayBias = 1e-3f;            // world units, keeps rays from hitting the surface they leave
+};
+
+// triangles flattened together along one direction, their vertices are contiguous
+struct LightmapChart {
+	unsigned int firstVertex;
+	unsigned int vertexCount;
+	glm::vec2 min;   // projected object units, before packing
+	glm::vec2 max;
+};
+
+// a static mesh instance : gets its own lightmap layer, its skinned meshes are left out of the bake
+struct LightmapInstance {
+	const std::vector<Mesh> *meshes;
+	glm::mat4 world;
+};
+
+struct LightmapStats {
+	size_t triangles = 0;    // in the BVH, every instance included
+	size_t texels = 0;       // covered by a chart, every layer included
+	size_t rays = 0;
+	float milliseconds = 0.0f; // trace, on the worker
+};
+
+/**
+ * Lighting of the static lights (directional and points) on static geometry, ray traced on the CPU.
+ * Import : each mesh is split in charts of similar normals, projected flat and packed with its siblings
+ * in one atlas (Vertex::lightmapCoords). Bake : a BVH is built over every instance, then the atlas is cut
+ * in tiles handed to the workers; every texel gets direct diffuse light with shadow rays, then one bounce
+ * gathered from the direct pass. The result is a GL_TEXTURE_2D_ARRAY with one layer per instance, the
+ * shader multiplies it by the albedo and only evaluates the dynamic lights (the spot light) live.
+ * bake() returns at once : the trace runs as a background job (which spreads the tiles over the other workers),
+ * update() then creates the texture on the GL thread.
+ **/
+class LightmapBaker {
+
+	private:
+		LightmapSettings m_settings;
+		bool m_enabled;
+		GLuint m_texture;
+		LightmapStats m_stats;
+
+		// bake job -> GL thread
+		std::mutex m_mutex;
+		std::condition_variable m_bakeDone;
+		bool m_baking;
+		bool m_baked;                          // m_bakedTexels waits for update()
+		std::vector<glm::vec3> m_bakedTexels;  // every layer, dilated
+		int m_bakedLayers;
+		LightmapStats m_bakedStats;
+		std::atomic<bool> m_cancel;            // set by shutdown, the tile jobs stop early
+
+		LightmapBaker();
+
+		// worker, no GL calls : false when cancelled or when there is nothing static to bake
+		bool trace(JobSystem &jobs, const std::vector<LightmapInstance> &instances, const LightData &lights, std::vector<glm::vec3> &texels, LightmapStats &stats) const;
+
+	public:
+		static LightmapBaker &get();
+
+		// before any model is imported : the imports then generate lightmap coordinates
+		void enable(LightmapSettings settings = LightmapSettings());
+
+		inline bool isEnabled() const {
+			return m_enabled;
+		}
+
+		// import thread : vertices shared by several charts are duplicated, indices are remapped
+		void buildCharts(std::vector<Vertex> &vertices, std::vector<unsigned int> &indices, std::vector<LightmapChart> &charts) const;
+
+		// import thread : packs the charts of every mesh in the atlas, lightmapCoords end up in [0, 1]
+		bool packCharts(std::vector<MeshData> &meshes) const;
+
+		// any thread, returns at once : false while an earlier bake is still running.
+		// The meshes must outlive the bake, shutdown() waits for it
+		bool bake(JobSystem &jobs, const std::vector<LightmapInstance> &instances, const LightData &lights);
+
+		// GL thread : creates the texture once a bake is over, none when every mesh is skinned
+		void update();
+
+		// GL thread : cancels a running bake and waits for it
+		void shutdown();
+
+		inline GLuint getTexture() const {
+			return m_texture;
+		}
+
+		// GL thread : the last bake update() picked up
+		inline const LightmapStats &getStats() const {
+			return m_stats;
+		}
+
+		inline const LightmapSettings &getSettings() const {
+			return m_settings;
+		}
+
+};
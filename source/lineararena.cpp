@@ -0,0 +1,32 @@
+#include "lineararena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+LinearArena::LinearArena(size_t capacity) :
+	m_memory(capacity),
+	m_head(0),
+	m_highWater(0),
+	m_overflows(0) {
+}
+
+void *LinearArena::allocate(size_t size, size_t alignment) {
+
+	// align the address, not the offset : the block itself is only aligned for the largest scalar
+	uintptr_t base = (uintptr_t)m_memory.data();
+	uintptr_t start = (base + m_head + alignment - 1) / alignment * alignment;
+	size_t end = (size_t)(start - base) + size;
+
+	if (end > m_memory.size()) {
+		m_overflows++;
+		return nullptr;
+	}
+
+	m_head = end;
+	m_highWater = std::max(m_highWater, m_head);
+	return (void *)start;
+}
+
+void LinearArena::reset() {
+	m_head = 0;
+}
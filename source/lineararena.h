@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+
+/**
+ * Bump allocator over a fixed block : allocations are never freed one by one, reset() drops them all at once.
+ * Nothing is constructed or destroyed, so only trivially copyable types go in it.
+ **/
+class LinearArena {
+
+	private:
+		std::vector<char> m_memory;
+		size_t m_head;
+		size_t m_highWater;           // largest amount in use between two resets
+		unsigned long long m_overflows;
+
+	public:
+		explicit LinearArena(size_t capacity);
+
+		LinearArena(const LinearArena &) = delete;
+		LinearArena &operator=(const LinearArena &) = delete;
+
+		// nullptr when the block is full
+		void *allocate(size_t size, size_t alignment);
+
+		template<typename T>
+		T *allocateArray(size_t count) {
+			static_assert(std::is_trivially_copyable<T>::value, "LinearArena does not run constructors or destructors");
+			return static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+		}
+
+		void reset();
+
+		inline size_t getUsed() const {
+			return m_head;
+		}
+
+		inline size_t getCapacity() const {
+			return m_memory.size();
+		}
+
+		inline size_t getHighWater() const {
+			return m_highWater;
+		}
+
+		inline unsigned long long getOverflows() const {
+			return m_overflows;
+		}
+
+};
@@ -0,0 +1,203 @@
+#include "lz4.h"
+
+#include <cstdint>
+#include <cstring>
+
+// constraints of the block format : the last 5 bytes are always literals
+// and the last match starts at least 12 bytes before the end
+const size_t LZ4_MIN_MATCH = 4;
+const size_t LZ4_LAST_LITERALS = 5;
+const size_t LZ4_MATCH_FIND_LIMIT = 12;
+const size_t LZ4_MAX_OFFSET = 65535;
+const int LZ4_HASH_LOG = 12;
+
+static inline uint32_t read32(const char *p) {
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static inline uint32_t hash32(uint32_t sequence) {
+	return (sequence * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+// lengths of 15 and more continue in extra bytes : 255, 255, ..., remainder
+static inline bool writeLength(char *dst, size_t &op, size_t dstCapacity, size_t length) {
+	while (length >= 255) {
+		if (op >= dstCapacity) {
+			return false;
+		}
+		dst[op++] = (char)255;
+		length -= 255;
+	}
+	if (op >= dstCapacity) {
+		return false;
+	}
+	dst[op++] = (char)length;
+	return true;
+}
+
+static inline bool readLength(const unsigned char *src, size_t &ip, size_t srcSize, size_t &length) {
+	unsigned char byte;
+	do {
+		if (ip >= srcSize) {
+			return false;
+		}
+		byte = src[ip++];
+		length += byte;
+	} while (byte == 255);
+	return true;
+}
+
+static bool writeSequence(char *dst, size_t &op, size_t dstCapacity, const char *literals, size_t literalLength, size_t offset, size_t matchLength) {
+
+	if (op >= dstCapacity) {
+		return false;
+	}
+
+	size_t tokenPos = op++;
+	unsigned char token = (unsigned char)((literalLength < 15 ? literalLength : 15) << 4);
+
+	if (literalLength >= 15 && !writeLength(dst, op, dstCapacity, literalLength - 15)) {
+		return false;
+	}
+
+	if (op + literalLength > dstCapacity) {
+		return false;
+	}
+	if (literalLength > 0) {
+		std::memcpy(dst + op, literals, literalLength);
+		op += literalLength;
+	}
+
+	// last sequence : literals only
+	if (matchLength == 0) {
+		dst[tokenPos] = (char)token;
+		return true;
+	}
+
+	if (op + 2 > dstCapacity) {
+		return false;
+	}
+	dst[op++] = (char)(offset & 0xFF);
+	dst[op++] = (char)(offset >> 8);
+
+	size_t storedMatch = matchLength - LZ4_MIN_MATCH;
+	token |= (unsigned char)(storedMatch < 15 ? storedMatch : 15);
+	if (storedMatch >= 15 && !writeLength(dst, op, dstCapacity, storedMatch - 15)) {
+		return false;
+	}
+
+	dst[tokenPos] = (char)token;
+	return true;
+}
+
+size_t Lz4CompressBound(size_t size) {
+	return size + size / 255 + 16;
+}
+
+size_t Lz4Compress(const char *src, size_t srcSize, char *dst, size_t dstCapacity) {
+
+	size_t op = 0;
+	size_t anchor = 0;
+
+	if (srcSize > LZ4_MATCH_FIND_LIMIT) {
+
+		int32_t table[1 << LZ4_HASH_LOG];
+		for (int i = 0; i < (1 << LZ4_HASH_LOG); i++) {
+			table[i] = -1;
+		}
+
+		size_t limit = srcSize - LZ4_MATCH_FIND_LIMIT;
+		size_t matchLimit = srcSize - LZ4_LAST_LITERALS;
+		size_t ip = 0;
+
+		// greedy parse : take the first 4 byte match the hash table remembers
+		while (ip < limit) {
+			uint32_t sequence = read32(src + ip);
+			uint32_t h = hash32(sequence);
+			int32_t candidate = table[h];
+			table[h] = (int32_t)ip;
+
+			if (candidate < 0 || ip - candidate > LZ4_MAX_OFFSET || read32(src + candidate) != sequence) {
+				ip++;
+				continue;
+			}
+
+			size_t matchLength = LZ4_MIN_MATCH;
+			while (ip + matchLength < matchLimit && src[candidate + matchLength] == src[ip + matchLength]) {
+				matchLength++;
+			}
+
+			if (!writeSequence(dst, op, dstCapacity, src + anchor, ip - anchor, ip - candidate, matchLength)) {
+				return 0;
+			}
+
+			ip += matchLength;
+			anchor = ip;
+		}
+	}
+
+	if (!writeSequence(dst, op, dstCapacity, src + anchor, srcSize - anchor, 0, 0)) {
+		return 0;
+	}
+
+	return op;
+}
+
+bool Lz4Decompress(const char *source, size_t srcSize, char *dst, size_t dstSize) {
+
+	const unsigned char *src = (const unsigned char *)source;
+	size_t ip = 0;
+	size_t op = 0;
+
+	while (ip < srcSize) {
+
+		unsigned char token = src[ip++];
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !readLength(src, ip, srcSize, literalLength)) {
+			return false;
+		}
+		if (ip + literalLength > srcSize || op + literalLength > dstSize) {
+			return false;
+		}
+		if (literalLength > 0) {
+			std::memcpy(dst + op, src + ip, literalLength);
+			ip += literalLength;
+			op += literalLength;
+		}
+
+		// the block always ends with literals
+		if (ip == srcSize) {
+			break;
+		}
+
+		if (ip + 2 > srcSize) {
+			return false;
+		}
+		size_t offset = src[ip] | (src[ip + 1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op) {
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !readLength(src, ip, srcSize, matchLength)) {
+			return false;
+		}
+		matchLength += LZ4_MIN_MATCH;
+		if (op + matchLength > dstSize) {
+			return false;
+		}
+
+		// matches may overlap the bytes they produce, copy forward one byte at a time
+		const char *match = dst + op - offset;
+		for (size_t i = 0; i < matchLength; i++) {
+			dst[op + i] = match[i];
+		}
+		op += matchLength;
+	}
+
+	return op == dstSize;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+// LZ4 block format (no frame header) : fast enough to decompress while streaming assets in
+
+// worst case size of the compressed output
+size_t Lz4CompressBound(size_t size);
+
+// returns the compressed size, or 0 when the output does not fit in dstCapacity
+size_t Lz4Compress(const char *src, size_t srcSize, char *dst, size_t dstCapacity);
+
+// dstSize must be the exact decompressed size, returns false on corrupted input
+bool Lz4Decompress(const char *src, size_t srcSize, char *dst, size_t dstSize);
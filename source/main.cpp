@@ -11,10 +11,28 @@
 #include <sstream>
 #include <fstream>
 #include <string>
+#include <cstdlib>
+#include <cstring>
 
 #include "shader.h"
 #include "model.h"
 #include "camera.h"
+#include "renderscaler.h"
+#include "jobsystem.h"
+#include "transformsystem.h"
+#include "modelloader.h"
+#include "ringbuffer.h"
+#include "shaderdata.h"
+#include "occlusionculler.h"
+#include "vfs.h"
+#include "memorytracker.h"
+#include "texturestreamer.h"
+#include "renderqueue.h"
+#include "meshletculler.h"
+#include "lightmapbaker.h"
+#include "animationsystem.h"
+#include "glcapture.h"
+#include "renderthread.h"
 #include <stb_image.h>
 
 /**
@@ -51,6 +69,14 @@ float lastFrame = 0.0f;
 int width = 800;
 int height = 800;
 
+// F10, consumed by the next frame packet
+bool memoryReportRequested = false;
+
+#ifdef _DEBUG
+// F12, consumed by the next frame packet
+bool captureRequested = false;
+#endif
+
 // Camera
 Camera camera(glm::vec3(0.0f, 0.0f, 5.0f));
 bool firstMouse = true;
@@ -81,7 +107,37 @@ glm::vec3 testPositions[] = {
 };
 
 
-int main(void) {
+int main(int argc, char **argv) {
+
+	// Packer : GuiGameBou --pack <directory> <output>
+	if (argc == 4 && std::string(argv[1]) == "--pack") {
+		JobSystem jobs;
+		exit(BuildPack(argv[2], argv[3], jobs) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// Capture report : GuiGameBou --analyze-capture <file> [--verbose]
+	if ((argc == 3 || argc == 4) && std::string(argv[1]) == "--analyze-capture") {
+		bool verbose = argc == 4 && std::string(argv[3]) == "--verbose";
+		exit(AnalyzeCapture(argv[2], verbose) ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	// GuiGameBou --bake-lightmaps : static lights traced on the CPU once the model is loaded
+	bool bakeLightmaps = false;
+	for (int i = 1; i < argc; i++) {
+		bakeLightmaps = bakeLightmaps || std::string(argv[i]) == "--bake-lightmaps";
+	}
+
+#ifdef _DEBUG
+	// GuiGameBou --capture-frame <n> : capture frame n to capture.glc, F12 captures the next one
+	long captureFrame = -1;
+	for (int i = 1; i + 1 < argc; i++) {
+		if (std::string(argv[i]) == "--capture-frame") {
+			captureFrame = std::strtol(argv[i + 1], nullptr, 10);
+		}
+	}
+	long frameIndex = 0;
+#endif
+
 	GLFWwindow *window;
 	glfwSetErrorCallback(error_callback);
 
@@ -118,21 +174,229 @@ int main(void) {
 
 	glDebugMessageCallback(opengl_error_callback, nullptr);
 
+#ifdef _DEBUG
+	GlCapture::install();
+#endif
+
+	// Memory accounting : budgets of the level, F10 writes memory.json
+	MemoryTracker::get().init();
+	MemoryTracker::get().setBudget(MemoryCategory::TEXTURE, 512 * 1024 * 1024);
+	MemoryTracker::get().setBudget(MemoryCategory::GEOMETRY, 256 * 1024 * 1024);
+
 	// UVs
 	//Either use both this AND aiProcess_FlipUVs in model with assimp
 	//Or nothing
 	//stbi_set_flip_vertically_on_load(true);
 
+	// Assets : read from the pack when there is one, loose files otherwise
+	JobSystem jobs;
+	Vfs::get().setJobSystem(&jobs);
+	Vfs::get().mount("resources.pak");
+
 	// Shader program
 	Shader modelShader{ "resources/shaders/shader.vert", "resources/shaders/shader.frag" };
 	modelShader.use();
 
-	// Models
-	Model backpack("resources/models/backpack/backpack.obj");
+	// Textures : only the small mips at first, finer ones streamed in as objects get close
+	StreamSettings streamSettings;
+	streamSettings.budgetBytes = 256 * 1024 * 1024;
+	streamSettings.tailSize = 64;
+	TextureStreamer::get().init(jobs, streamSettings);
+
+	// Lightmaps : the imports generate the lightmap coordinates
+	if (bakeLightmaps) {
+		LightmapBaker::get().enable();
+	}
+
+	// Models : imported on the workers, uploaded a bit every frame, drawn once ready
+	UploadBudget uploadBudget;
+	uploadBudget.maxBytes = 8 * 1024 * 1024;
+	uploadBudget.maxMilliseconds = 2.0f;
+	ModelLoader modelLoader(jobs, uploadBudget);
+
+	ModelHandle backpack = modelLoader.load("resources/models/backpack/backpack.obj", [](const std::string &path, LoadState state) {
+		if (state == LoadState::READY) {
+			std::cout << "Model ready : " << path << std::endl;
+		} else if (state == LoadState::FAILED) {
+			std::cout << "Model failed : " << path << std::endl;
+		}
+	});
+
+	// Dynamic resolution : the scene is rendered offscreen at a scale driven by the GPU frame time
+	RenderScaleSettings scaleSettings;
+	scaleSettings.targetFrameTime = 1000.0f / 60.0f;
+	scaleSettings.minScale = 0.5f;
+	scaleSettings.maxScale = 1.0f;
+	RenderScaler renderScaler(width, height, scaleSettings);
+
+	// Objects : matrices are only rebuilt when a transform changes
+	TransformSystem transforms;
+	std::vector<TransformHandle> objects;
+	for (unsigned int i = 0; i < 10; i++) {
+		float angle = 20.0f * i;
+		glm::quat rotation = glm::angleAxis(glm::radians(angle), glm::normalize(glm::vec3(1.0f, 0.3f, 0.5f)));
+		objects.push_back(transforms.create(testPositions[i], rotation, glm::vec3(0.3f)));
+	}
+
+	// Per frame data (camera, lights, objects, bone palettes) : written in a persistently mapped buffer, no implicit sync
+	// the palettes take most of it : 48 bytes per joint per animated instance
+	RingBuffer ringBuffer(4 * 1024 * 1024);
+
+	// Software occlusion culling, no GPU readback
+	OcclusionCuller occlusionCuller(jobs, 256, 128);
+
+	// Draws are collected on the workers, sorted by state then depth, and submitted with as few binds as possible
+	RenderQueue renderQueue(jobs);
+	uint16_t modelProgram = renderQueue.registerProgram(&modelShader);
+	std::vector<char> visible(objects.size());
+
+	// Meshlets : frustum and backface culled per cluster, survivors drawn indirectly
+	MeshletCuller meshletCuller(jobs);
+
+	// Static lights (directional and points) : baked when --bake-lightmaps is set, the spot light follows the camera
+	LightData lights;
+	// directional light
+	lights.dirLight.direction = glm::vec3(-0.2f, -1.0f, -0.3f);
+	lights.dirLight.ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+	lights.dirLight.diffuse = glm::vec3(0.4f, 0.4f, 0.4f);
+	lights.dirLight.specular = glm::vec3(0.5f, 0.5f, 0.5f);
+	// point lights
+	for (unsigned int i = 0; i < NR_POINT_LIGHTS; i++) {
+		lights.pointLights[i].position = pointLightPositions[i];
+		lights.pointLights[i].ambient = glm::vec3(0.05f, 0.05f, 0.05f);
+		lights.pointLights[i].diffuse = glm::vec3(0.8f, 0.8f, 0.8f);
+		lights.pointLights[i].specular = glm::vec3(1.0f, 1.0f, 1.0f);
+		lights.pointLights[i].constant = 1.0f;
+		lights.pointLights[i].linear = 0.09f;
+		lights.pointLights[i].quadratic = 0.032f;
+	}
+	bool lightmapBakeStarted = false; // render thread only
+
+	// Skeletal animation : poses evaluated on the workers, vertices skinned in shader.vert
+	AnimationSystem animations(jobs);
+	std::vector<AnimationHandle> animated; // one per object once a skinned model is ready
 
 	//Options
 	glEnable(GL_DEPTH_TEST);
 
+	// Render thread : owns the GL context from here on and draws the packets this thread builds,
+	// at most packetCount frames behind
+	RenderThreadSettings renderSettings;
+	renderSettings.packetCount = 2;
+	renderSettings.arenaBytes = 4 * 1024 * 1024;
+	RenderThread renderThread(window, renderSettings);
+
+	renderThread.start([&](const FramePacket &packet) {
+
+		// before the capture starts : the driver queries are not part of the frame
+		if (packet.memoryReport && MemoryTracker::get().dumpJson("memory.json")) {
+			std::cout << "Memory report written to memory.json" << std::endl;
+		}
+
+#ifdef _DEBUG
+		if (packet.captureFrame) {
+			GlCapture::requestFrame("capture.glc");
+		}
+		GlCapture::beginFrame();
+#endif
+
+		modelLoader.update();
+
+		renderScaler.resize(packet.width, packet.height);
+		renderScaler.beginFrame();
+
+		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		ringBuffer.beginFrame();
+
+		modelShader.use();
+		modelShader.setFloat("material.shininess", 32.0f); //TODO : extract from assimp model
+
+		ringBuffer.upload(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, &packet.lights, sizeof(packet.lights));
+		ringBuffer.upload(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, &packet.camera, sizeof(packet.camera));
+
+		// transforms are static : bake once, as soon as the model is there. The trace runs on a worker,
+		// the texture shows up a few seconds later
+		if (bakeLightmaps && !lightmapBakeStarted && backpack->isReady()) {
+			std::vector<LightmapInstance> instances;
+			for (uint32_t i = 0; i < packet.objectCount; i++) {
+				LightmapInstance instance;
+				instance.meshes = &backpack->getMeshes();
+				instance.world = packet.objects[i].model;
+				instances.push_back(instance);
+			}
+			lightmapBakeStarted = LightmapBaker::get().bake(jobs, instances, packet.lights);
+		}
+		LightmapBaker::get().update();
+		GLuint lightmap = LightmapBaker::get().getTexture();
+		if (lightmap) {
+			glBindTextureUnit(LIGHTMAP_TEXTURE_UNIT, lightmap);
+		}
+
+		bool skinning = packet.paletteCount > 0 && ringBuffer.upload(GL_SHADER_STORAGE_BUFFER, BONE_PALETTE_BINDING, packet.palette, (GLsizeiptr)(packet.paletteCount * sizeof(BoneMatrix)));
+
+		//backpack->draw(modelShader);
+
+		if (backpack->isReady() && renderQueue.beginFrame(ringBuffer, packet.objectCount, packet.camera.view, 100.0f)) {
+
+			const std::vector<Mesh> &meshes = backpack->getMeshes();
+
+			meshletCuller.beginFrame(ringBuffer, packet.camera.proj * packet.camera.view, packet.camera.viewPos);
+
+			// emit : one object slot per visible object, one draw item per mesh surviving the meshlet culling
+			jobs.parallelFor(packet.visibleCount, 64, [&](size_t begin, size_t end, unsigned int) {
+				for (size_t v = begin; v < end; v++) {
+
+					uint32_t slot = packet.visible[v];
+					ObjectData objectData = packet.objects[slot];
+					// what the main thread asked for, minus what this thread could not provide
+					if (!lightmap) {
+						objectData.lightmapLayer = -1;
+					}
+					if (!skinning) {
+						objectData.boneOffset = -1;
+					}
+					renderQueue.writeObject(slot, objectData);
+
+					const glm::mat4 &world = objectData.model;
+					for (size_t m = 0; m < meshes.size(); m++) {
+						GLintptr commandOffset;
+						uint32_t commandCount;
+						if (!meshletCuller.cull(meshes[m], world, commandOffset, commandCount)) {
+							continue;
+						}
+						glm::vec3 center = glm::vec3(world * glm::vec4((meshes[m].boundsMin + meshes[m].boundsMax) * 0.5f, 1.0f));
+						renderQueue.push(RenderPass::OPAQUE_PASS, modelProgram, meshes[m], slot, center, commandOffset, commandCount);
+					}
+				}
+			});
+
+			// the streamer is not thread safe : mip requests stay on this thread
+			TextureStreamer::get().setView(packet.camera.viewPos, packet.fovY, (float)renderScaler.getRenderHeight());
+			for (uint32_t v = 0; v < packet.visibleCount; v++) {
+				for (size_t m = 0; m < meshes.size(); m++) {
+					TextureStreamer::get().requestMips(meshes[m], packet.objects[packet.visible[v]].model);
+				}
+			}
+
+			renderQueue.sort();
+			renderQueue.submit(ringBuffer);
+		}
+
+		TextureStreamer::get().update();
+
+		ringBuffer.endFrame();
+
+		renderScaler.endFrame();
+
+		glfwSwapBuffers(window);
+
+#ifdef _DEBUG
+		GlCapture::endFrame();
+#endif
+	});
+
 	while (!glfwWindowShouldClose(window)) {
 
 		float currentFrame = glfwGetTime();
@@ -142,96 +406,113 @@ int main(void) {
 
 		key_callback(window);
 
-		//glfwGetFramebufferSize(window, &width, &height);
+		// waits here when the render thread is packetCount frames behind
+		FramePacket &packet = renderThread.beginPacket();
+		packet.width = width;
+		packet.height = height;
 
-		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		packet.memoryReport = memoryReportRequested;
+		memoryReportRequested = false;
 
-		
-		modelShader.use();
-		modelShader.setVec3("viewPos", camera.getPosition());
-		modelShader.setFloat("material.shininess", 32.0f); //TODO : extract from assimp model
+#ifdef _DEBUG
+		packet.captureFrame = frameIndex++ == captureFrame || captureRequested;
+		captureRequested = false;
+#endif
 
-		// directional light
-		modelShader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-		modelShader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-		modelShader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-		modelShader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-		// point light 1
-		modelShader.setVec3("pointLights[0].position", pointLightPositions[0]);
-		modelShader.setVec3("pointLights[0].ambient", 0.05f, 0.05f, 0.05f);
-		modelShader.setVec3("pointLights[0].diffuse", 0.8f, 0.8f, 0.8f);
-		modelShader.setVec3("pointLights[0].specular", 1.0f, 1.0f, 1.0f);
-		modelShader.setFloat("pointLights[0].constant", 1.0f);
-		modelShader.setFloat("pointLights[0].linear", 0.09);
-		modelShader.setFloat("pointLights[0].quadratic", 0.032);
-		// point light 2
-		modelShader.setVec3("pointLights[1].position", pointLightPositions[1]);
-		modelShader.setVec3("pointLights[1].ambient", 0.05f, 0.05f, 0.05f);
-		modelShader.setVec3("pointLights[1].diffuse", 0.8f, 0.8f, 0.8f);
-		modelShader.setVec3("pointLights[1].specular", 1.0f, 1.0f, 1.0f);
-		modelShader.setFloat("pointLights[1].constant", 1.0f);
-		modelShader.setFloat("pointLights[1].linear", 0.09);
-		modelShader.setFloat("pointLights[1].quadratic", 0.032);
-		// point light 3
-		modelShader.setVec3("pointLights[2].position", pointLightPositions[2]);
-		modelShader.setVec3("pointLights[2].ambient", 0.05f, 0.05f, 0.05f);
-		modelShader.setVec3("pointLights[2].diffuse", 0.8f, 0.8f, 0.8f);
-		modelShader.setVec3("pointLights[2].specular", 1.0f, 1.0f, 1.0f);
-		modelShader.setFloat("pointLights[2].constant", 1.0f);
-		modelShader.setFloat("pointLights[2].linear", 0.09);
-		modelShader.setFloat("pointLights[2].quadratic", 0.032);
-		// point light 4
-		modelShader.setVec3("pointLights[3].position", pointLightPositions[3]);
-		modelShader.setVec3("pointLights[3].ambient", 0.05f, 0.05f, 0.05f);
-		modelShader.setVec3("pointLights[3].diffuse", 0.8f, 0.8f, 0.8f);
-		modelShader.setVec3("pointLights[3].specular", 1.0f, 1.0f, 1.0f);
-		modelShader.setFloat("pointLights[3].constant", 1.0f);
-		modelShader.setFloat("pointLights[3].linear", 0.09);
-		modelShader.setFloat("pointLights[3].quadratic", 0.032);
 		// spotLight
-		modelShader.setVec3("spotLight.position", camera.getPosition());
-		modelShader.setVec3("spotLight.direction", camera.getFront());
-		modelShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-		modelShader.setVec3("spotLight.diffuse", 1.0f, 1.0f, 1.0f);
-		modelShader.setVec3("spotLight.specular", 1.0f, 1.0f, 1.0f);
-		modelShader.setFloat("spotLight.constant", 1.0f);
-		modelShader.setFloat("spotLight.linear", 0.09);
-		modelShader.setFloat("spotLight.quadratic", 0.032);
-		modelShader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-		modelShader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+		lights.spotLight.position = camera.getPosition();
+		lights.spotLight.direction = camera.getFront();
+		lights.spotLight.ambient = glm::vec3(0.0f, 0.0f, 0.0f);
+		lights.spotLight.diffuse = glm::vec3(1.0f, 1.0f, 1.0f);
+		lights.spotLight.specular = glm::vec3(1.0f, 1.0f, 1.0f);
+		lights.spotLight.constant = 1.0f;
+		lights.spotLight.linear = 0.09f;
+		lights.spotLight.quadratic = 0.032f;
+		lights.spotLight.cutOff = glm::cos(glm::radians(12.5f));
+		lights.spotLight.outerCutOff = glm::cos(glm::radians(15.0f));
+		packet.lights = lights;
 
 		//Camera
-		glm::mat4 proj = glm::perspective(glm::radians(camera.getFov()), (float)width / (float)height, 0.1f, 100.0f);
-		glm::mat4 view = camera.getViewMatrix();
-		modelShader.setMat4("proj", proj);
-		modelShader.setMat4("view", view);
+		packet.camera.proj = glm::perspective(glm::radians(camera.getFov()), (float)width / (float)height, 0.1f, 100.0f);
+		packet.camera.view = camera.getViewMatrix();
+		packet.camera.viewPos = camera.getPosition();
+		packet.fovY = glm::radians(camera.getFov());
 
 		// world transformation
-		glm::mat4 model = glm::mat4(1.0f);
-		modelShader.setMat4("model", model);
-
-		//backpack.draw(modelShader);
-
-		for (unsigned int i = 0; i < 10; i++) {
-
-			glm::mat4 model = glm::mat4(1.0f);
-			model = glm::translate(model, testPositions[i]);
-			float angle = 20.0f * i;
-			model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
-			model = glm::scale(model, glm::vec3(0.3f));
-
-			modelShader.setMat4("model", model);
+		transforms.update(jobs);
+
+		// every object plays the first clip of a skinned model
+		if (animated.empty() && backpack->isReady() && backpack->isSkinned()) {
+			const std::vector<AnimationClip> &clips = backpack->getClips();
+			for (size_t i = 0; i < objects.size(); i++) {
+				animated.push_back(animations.create(backpack->getSkeleton()));
+				animations.play(animated.back(), clips.empty() ? nullptr : &clips[0], 0.0f);
+			}
+		}
+		animations.update(jobs, deltaTime);
+
+		const std::vector<BoneMatrix> &palette = animations.getPalette();
+		BoneMatrix *packetPalette = packet.arena.allocateArray<BoneMatrix>(palette.size());
+		if (packetPalette && !palette.empty()) {
+			std::memcpy(packetPalette, palette.data(), palette.size() * sizeof(BoneMatrix));
+			packet.palette = packetPalette;
+			packet.paletteCount = palette.size();
+		}
 
-			backpack.draw(modelShader);
+		// per object data, the render thread only copies it
+		ObjectData *objectData = packet.arena.allocateArray<ObjectData>(objects.size());
+		uint32_t *visibleSlots = packet.arena.allocateArray<uint32_t>(objects.size());
+		if (objectData && visibleSlots) {
+			for (size_t i = 0; i < objects.size(); i++) {
+				objectData[i].model = transforms.getWorldMatrix(objects[i]);
+				objectData[i].normalMatrix = glm::mat4(transforms.getNormalMatrix(objects[i]));
+				// animated objects are lit live, only static ones sample the lightmaps
+				objectData[i].lightmapLayer = bakeLightmaps && i >= animated.size() ? (int)i : -1;
+				objectData[i].boneOffset = packet.palette ? animations.getPaletteOffset(animated[i]) : -1;
+			}
+			packet.objects = objectData;
+			packet.objectCount = (uint32_t)objects.size();
+			packet.visible = visibleSlots;
 		}
 
+		// occlusion : the nearest object hides what is behind it, rasterized on the CPU
+		if (backpack->isReady() && packet.objects) {
+			glm::vec3 boundsMin, boundsMax;
+			backpack->getBounds(boundsMin, boundsMax);
+
+			occlusionCuller.beginFrame(packet.camera.proj * packet.camera.view);
+			const std::vector<Mesh> &meshes = backpack->getMeshes();
+			for (size_t m = 0; m < meshes.size(); m++) {
+				if (meshes[m].vertices.empty()) {
+					continue;
+				}
+				occlusionCuller.addOccluder(&meshes[m].vertices[0].position, sizeof(Vertex), meshes[m].indices.data(), meshes[m].indices.size(), transforms.getWorldMatrix(objects[0]));
+			}
+			occlusionCuller.rasterize();
+
+			jobs.parallelFor(objects.size(), 64, [&](size_t begin, size_t end, unsigned int) {
+				for (size_t i = begin; i < end; i++) {
+					visible[i] = occlusionCuller.isVisible(boundsMin, boundsMax, transforms.getWorldMatrix(objects[i]));
+				}
+			});
+			for (size_t i = 0; i < objects.size(); i++) {
+				if (visible[i]) {
+					visibleSlots[packet.visibleCount++] = (uint32_t)i;
+				}
+			}
+		}
 
+		renderThread.submitPacket(packet);
 
-		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
+	// the last packets are drawn, then the context comes back here for the shutdown
+	renderThread.stop();
+
+	TextureStreamer::get().shutdown();
+	LightmapBaker::get().shutdown();
+
 	glfwDestroyWindow(window);
 	glfwTerminate();
 
@@ -243,8 +524,10 @@ static void error_callback(int /*error*/, const char *description) {
 	std::cerr << "Error: " << description << std::endl;
 }
 
-static void framebuffer_size_callback(GLFWwindow *window, int width, int height) {
-	glViewport(0, 0, width, height);
+static void framebuffer_size_callback(GLFWwindow *window, int newWidth, int newHeight) {
+	// viewports are set by the RenderScaler every frame
+	width = newWidth;
+	height = newHeight;
 }
 
 static void key_callback(GLFWwindow *window) {
@@ -252,6 +535,23 @@ static void key_callback(GLFWwindow *window) {
 		glfwSetWindowShouldClose(window, true);
 	}
 
+	// polled every frame : only act when the key goes down
+	static bool memoryKeyDown = false;
+	bool memoryKey = glfwGetKey(window, GLFW_KEY_F10) == GLFW_PRESS;
+	if (memoryKey && !memoryKeyDown) {
+		memoryReportRequested = true; // the report queries the driver : written by the render thread
+	}
+	memoryKeyDown = memoryKey;
+
+#ifdef _DEBUG
+	static bool captureKeyDown = false;
+	bool captureKey = glfwGetKey(window, GLFW_KEY_F12) == GLFW_PRESS;
+	if (captureKey && !captureKeyDown) {
+		captureRequested = true; // the render thread starts the capture with the next packet
+	}
+	captureKeyDown = captureKey;
+#endif
+
 	if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
 		camera.keyProcess(CameraMovement::FORWARD, deltaTime);
 	}
@@ -0,0 +1,418 @@
+#include "memorytracker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+
+// GL_NVX_gpu_memory_info, values in KB
+#ifndef GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX
+#define GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX 0x9047
+#define GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX 0x9048
+#define GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX 0x9049
+#define GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX 0x904A
+#define GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX 0x904B
+#endif
+
+// GL_ATI_meminfo, 4 values in KB : the first one is the total free memory of the pool
+#ifndef GL_VBO_FREE_MEMORY_ATI
+#define GL_VBO_FREE_MEMORY_ATI 0x87FB
+#define GL_TEXTURE_FREE_MEMORY_ATI 0x87FC
+#define GL_RENDERBUFFER_FREE_MEMORY_ATI 0x87FD
+#endif
+
+static inline uint64_t makeKey(MemoryKind kind, GLuint id) {
+	return ((uint64_t)kind << 32) | id;
+}
+
+static bool hasExtension(const char *name) {
+
+	GLint count = 0;
+	glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+
+	for (GLint i = 0; i < count; i++) {
+		const char *extension = (const char *)glGetStringi(GL_EXTENSIONS, i);
+		if (extension && std::strcmp(extension, name) == 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static std::string escapeJson(const std::string &text) {
+
+	std::string result;
+	result.reserve(text.size());
+	for (size_t i = 0; i < text.size(); i++) {
+		char c = text[i];
+		if (c == '"' || c == '\\') {
+			result += '\\';
+			result += c;
+		} else if ((unsigned char)c < 0x20) {
+			result += ' ';
+		} else {
+			result += c;
+		}
+	}
+	return result;
+}
+
+MemoryTracker &MemoryTracker::get() {
+	static MemoryTracker instance;
+	return instance;
+}
+
+MemoryTracker::MemoryTracker() : m_totalHighWater(0), m_hasNvx(false), m_hasAti(false), m_driverBaseline(0) {
+	for (int i = 0; i < (int)MemoryCategory::COUNT; i++) {
+		m_budgetWarned[i] = false;
+	}
+}
+
+void MemoryTracker::init() {
+
+	m_hasNvx = hasExtension("GL_NVX_gpu_memory_info");
+	m_hasAti = !m_hasNvx && hasExtension("GL_ATI_meminfo");
+
+	// whatever the driver already uses (desktop, other processes) is not ours
+	m_driverBaseline = 0;
+	DriverMemoryInfo info = queryDriver();
+	if (m_hasNvx) {
+		m_driverBaseline = info.dedicated - info.freeMemory;
+	} else if (m_hasAti) {
+		m_driverBaseline = info.freeMemory;
+	}
+
+	if (info.supported) {
+		std::cout << "Memory tracker : driver figures from " << info.source << std::endl;
+	}
+}
+
+const char *MemoryTracker::getCategoryName(MemoryCategory category) {
+	switch (category) {
+		case MemoryCategory::GEOMETRY: return "geometry";
+		case MemoryCategory::TEXTURE: return "texture";
+		case MemoryCategory::RENDER_TARGET: return "render_target";
+		case MemoryCategory::STREAMING: return "streaming";
+		case MemoryCategory::CPU_GEOMETRY: return "cpu_geometry";
+		default: return "unknown";
+	}
+}
+
+int MemoryTracker::getMipCount(int width, int height) {
+	int levels = 1;
+	int size = std::max(width, height);
+	while (size > 1) {
+		size >>= 1;
+		levels++;
+	}
+	return levels;
+}
+
+size_t MemoryTracker::getTextureBytes(int width, int height, GLenum internalFormat, int mipLevels) {
+
+	size_t bytesPerPixel;
+	switch (internalFormat) {
+		case GL_RED:
+		case GL_R8:
+			bytesPerPixel = 1;
+			break;
+		case GL_RG:
+		case GL_RG8:
+			bytesPerPixel = 2;
+			break;
+		case GL_RGBA16F:
+			bytesPerPixel = 8;
+			break;
+		case GL_RGBA32F:
+			bytesPerPixel = 16;
+			break;
+		default:
+			// RGB8 included : drivers pad it to 4 bytes
+			bytesPerPixel = 4;
+			break;
+	}
+
+	size_t bytes = 0;
+	for (int level = 0; level < mipLevels; level++) {
+		size_t levelWidth = std::max(1, width >> level);
+		size_t levelHeight = std::max(1, height >> level);
+		bytes += levelWidth * levelHeight * bytesPerPixel;
+	}
+	return bytes;
+}
+
+void MemoryTracker::add(const MemoryAllocation &allocation) {
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	uint64_t key = makeKey(allocation.kind, allocation.id);
+
+	// re-specifying an object (glBufferData, glTexImage2D again) replaces its previous storage
+	std::unordered_map<uint64_t, MemoryAllocation>::iterator previous = m_allocations.find(key);
+	if (previous != m_allocations.end()) {
+		CategoryUsage &usage = m_usage[(int)previous->second.category];
+		usage.bytes -= previous->second.bytes;
+		usage.count--;
+		m_allocations.erase(previous);
+	}
+
+	m_allocations[key] = allocation;
+
+	int index = (int)allocation.category;
+	CategoryUsage &usage = m_usage[index];
+	usage.bytes += allocation.bytes;
+	usage.count++;
+	usage.highWater = std::max(usage.highWater, usage.bytes);
+
+	m_totalHighWater = std::max(m_totalHighWater, getTotalGpuBytesLocked());
+
+	if (usage.budget > 0 && usage.bytes > usage.budget && !m_budgetWarned[index]) {
+		m_budgetWarned[index] = true;
+		std::cout << "ERROR::MEMORY_TRACKER::BUDGET_EXCEEDED::" << getCategoryName(allocation.category)
+			<< " (" << usage.bytes << " / " << usage.budget << " bytes, last : " << allocation.owner << ")" << std::endl;
+	}
+}
+
+void MemoryTracker::remove(MemoryKind kind, GLuint id) {
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::unordered_map<uint64_t, MemoryAllocation>::iterator it = m_allocations.find(makeKey(kind, id));
+	if (it == m_allocations.end()) {
+		return;
+	}
+
+	int index = (int)it->second.category;
+	CategoryUsage &usage = m_usage[index];
+	usage.bytes -= it->second.bytes;
+	usage.count--;
+	m_allocations.erase(it);
+
+	// back under budget : warn again next time
+	if (usage.budget == 0 || usage.bytes <= usage.budget) {
+		m_budgetWarned[index] = false;
+	}
+}
+
+void MemoryTracker::trackBuffer(GLuint id, size_t bytes, MemoryCategory category, const std::string &owner) {
+
+	MemoryAllocation allocation;
+	allocation.kind = MemoryKind::BUFFER;
+	allocation.category = category;
+	allocation.id = id;
+	allocation.bytes = bytes;
+	allocation.owner = owner;
+	add(allocation);
+}
+
+void MemoryTracker::trackTexture(GLuint id, int width, int height, GLenum internalFormat, int mipLevels, MemoryCategory category, const std::string &owner) {
+
+	MemoryAllocation allocation;
+	allocation.kind = MemoryKind::TEXTURE;
+	allocation.category = category;
+	allocation.id = id;
+	allocation.bytes = getTextureBytes(width, height, internalFormat, mipLevels);
+	allocation.format = internalFormat;
+	allocation.width = width;
+	allocation.height = height;
+	allocation.mipLevels = mipLevels;
+	allocation.owner = owner;
+	add(allocation);
+}
+
+void MemoryTracker::trackRenderbuffer(GLuint id, int width, int height, GLenum internalFormat, const std::string &owner) {
+
+	MemoryAllocation allocation;
+	allocation.kind = MemoryKind::RENDERBUFFER;
+	allocation.category = MemoryCategory::RENDER_TARGET;
+	allocation.id = id;
+	allocation.bytes = getTextureBytes(width, height, internalFormat, 1);
+	allocation.format = internalFormat;
+	allocation.width = width;
+	allocation.height = height;
+	allocation.mipLevels = 1;
+	allocation.owner = owner;
+	add(allocation);
+}
+
+void MemoryTracker::trackCpu(GLuint id, size_t bytes, MemoryCategory category, const std::string &owner) {
+
+	MemoryAllocation allocation;
+	allocation.kind = MemoryKind::CPU;
+	allocation.category = category;
+	allocation.id = id;
+	allocation.bytes = bytes;
+	allocation.owner = owner;
+	add(allocation);
+}
+
+void MemoryTracker::untrackBuffer(GLuint id) {
+	remove(MemoryKind::BUFFER, id);
+}
+
+void MemoryTracker::untrackTexture(GLuint id) {
+	remove(MemoryKind::TEXTURE, id);
+}
+
+void MemoryTracker::untrackRenderbuffer(GLuint id) {
+	remove(MemoryKind::RENDERBUFFER, id);
+}
+
+void MemoryTracker::untrackCpu(GLuint id) {
+	remove(MemoryKind::CPU, id);
+}
+
+void MemoryTracker::setBudget(MemoryCategory category, size_t bytes) {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_usage[(int)category].budget = bytes;
+	m_budgetWarned[(int)category] = false;
+}
+
+bool MemoryTracker::fitsBudget(MemoryCategory category, size_t bytes) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const CategoryUsage &usage = m_usage[(int)category];
+	return usage.budget == 0 || usage.bytes + bytes <= usage.budget;
+}
+
+CategoryUsage MemoryTracker::getUsage(MemoryCategory category) const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_usage[(int)category];
+}
+
+size_t MemoryTracker::getOwnerBytes(const std::string &owner) const {
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	size_t bytes = 0;
+	for (std::unordered_map<uint64_t, MemoryAllocation>::const_iterator it = m_allocations.begin(); it != m_allocations.end(); ++it) {
+		if (it->second.owner == owner) {
+			bytes += it->second.bytes;
+		}
+	}
+	return bytes;
+}
+
+size_t MemoryTracker::getTotalGpuBytesLocked() const {
+	size_t bytes = 0;
+	for (int i = 0; i < (int)MemoryCategory::COUNT; i++) {
+		if ((MemoryCategory)i != MemoryCategory::CPU_GEOMETRY) {
+			bytes += m_usage[i].bytes;
+		}
+	}
+	return bytes;
+}
+
+size_t MemoryTracker::getTotalGpuBytes() const {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return getTotalGpuBytesLocked();
+}
+
+DriverMemoryInfo MemoryTracker::queryDriver() const {
+
+	DriverMemoryInfo info;
+
+	if (m_hasNvx) {
+		GLint dedicated = 0, available = 0, evictionCount = 0, evicted = 0;
+		glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &dedicated);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTION_COUNT_NVX, &evictionCount);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_EVICTED_MEMORY_NVX, &evicted);
+
+		info.supported = true;
+		info.source = "GL_NVX_gpu_memory_info";
+		info.dedicated = (size_t)dedicated * 1024;
+		info.freeMemory = (size_t)available * 1024;
+		info.evicted = (size_t)evicted * 1024;
+		info.evictionCount = evictionCount;
+
+		size_t used = info.dedicated - info.freeMemory;
+		info.usedSinceInit = used > m_driverBaseline ? used - m_driverBaseline : 0;
+
+	} else if (m_hasAti) {
+		// the pools may share memory : the texture pool is the closest to a global figure
+		GLint texture[4] = { 0, 0, 0, 0 };
+		glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, texture);
+
+		info.supported = true;
+		info.source = "GL_ATI_meminfo";
+		info.freeMemory = (size_t)texture[0] * 1024;
+		info.usedSinceInit = m_driverBaseline > info.freeMemory ? m_driverBaseline - info.freeMemory : 0;
+	}
+
+	return info;
+}
+
+std::string MemoryTracker::toJson() const {
+
+	// driver first : it takes no lock
+	DriverMemoryInfo driver = queryDriver();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::ostringstream json;
+	json << "{\n";
+
+	json << "\t\"totalGpuBytes\": " << getTotalGpuBytesLocked() << ",\n";
+	json << "\t\"totalGpuHighWater\": " << m_totalHighWater << ",\n";
+
+	json << "\t\"categories\": {\n";
+	for (int i = 0; i < (int)MemoryCategory::COUNT; i++) {
+		const CategoryUsage &usage = m_usage[i];
+		json << "\t\t\"" << getCategoryName((MemoryCategory)i) << "\": { \"bytes\": " << usage.bytes
+			<< ", \"highWater\": " << usage.highWater << ", \"count\": " << usage.count << ", \"budget\": " << usage.budget << " }"
+			<< (i + 1 < (int)MemoryCategory::COUNT ? ",\n" : "\n");
+	}
+	json << "\t},\n";
+
+	// per owner, sorted so two dumps can be diffed
+	std::map<std::string, size_t> owners;
+	for (std::unordered_map<uint64_t, MemoryAllocation>::const_iterator it = m_allocations.begin(); it != m_allocations.end(); ++it) {
+		owners[it->second.owner] += it->second.bytes;
+	}
+	json << "\t\"owners\": {\n";
+	for (std::map<std::string, size_t>::const_iterator it = owners.begin(); it != owners.end(); ++it) {
+		json << "\t\t\"" << escapeJson(it->first) << "\": " << it->second << (std::next(it) != owners.end() ? ",\n" : "\n");
+	}
+	json << "\t},\n";
+
+	json << "\t\"driver\": { \"supported\": " << (driver.supported ? "true" : "false")
+		<< ", \"source\": \"" << driver.source << "\", \"dedicated\": " << driver.dedicated
+		<< ", \"free\": " << driver.freeMemory << ", \"usedSinceInit\": " << driver.usedSinceInit
+		<< ", \"evicted\": " << driver.evicted << ", \"evictionCount\": " << driver.evictionCount << " },\n";
+
+	std::map<uint64_t, const MemoryAllocation *> allocations;
+	for (std::unordered_map<uint64_t, MemoryAllocation>::const_iterator it = m_allocations.begin(); it != m_allocations.end(); ++it) {
+		allocations[it->first] = &it->second;
+	}
+	static const char *kindNames[] = { "buffer", "texture", "renderbuffer", "cpu" };
+	json << "\t\"allocations\": [\n";
+	for (std::map<uint64_t, const MemoryAllocation *>::const_iterator it = allocations.begin(); it != allocations.end(); ++it) {
+		const MemoryAllocation &allocation = *it->second;
+		json << "\t\t{ \"kind\": \"" << kindNames[(int)allocation.kind] << "\", \"category\": \"" << getCategoryName(allocation.category)
+			<< "\", \"id\": " << allocation.id << ", \"bytes\": " << allocation.bytes;
+		if (allocation.kind == MemoryKind::TEXTURE || allocation.kind == MemoryKind::RENDERBUFFER) {
+			json << ", \"format\": " << allocation.format << ", \"width\": " << allocation.width << ", \"height\": " << allocation.height
+				<< ", \"mipLevels\": " << allocation.mipLevels;
+		}
+		json << ", \"owner\": \"" << escapeJson(allocation.owner) << "\" }" << (std::next(it) != allocations.end() ? ",\n" : "\n");
+	}
+	json << "\t]\n";
+
+	json << "}\n";
+	return json.str();
+}
+
+bool MemoryTracker::dumpJson(const std::string &path) const {
+
+	std::ofstream out(path, std::ios::binary);
+	if (!out) {
+		std::cout << "ERROR::MEMORY_TRACKER::CANNOT_WRITE " << path << std::endl;
+		return false;
+	}
+
+	out << toJson();
+	return true;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <glad\glad.h>
+
+enum class MemoryCategory {
+	GEOMETRY,       // vertex and index buffers
+	TEXTURE,        // material textures
+	RENDER_TARGET,  // framebuffer attachments
+	STREAMING,      // per frame data (ring buffer)
+	CPU_GEOMETRY,   // vertex and index copies kept in RAM by the meshes
+	COUNT
+};
+
+enum class MemoryKind {
+	BUFFER,
+	TEXTURE,
+	RENDERBUFFER,
+	CPU
+};
+
+struct MemoryAllocation {
+	MemoryKind kind;
+	MemoryCategory category;
+	GLuint id;
+	size_t bytes = 0;
+	GLenum format = 0;   // internal format, 0 for buffers
+	int width = 0;
+	int height = 0;
+	int mipLevels = 0;
+	std::string owner;   // asset path, or the system owning it
+};
+
+struct CategoryUsage {
+	size_t bytes = 0;
+	size_t highWater = 0;
+	size_t count = 0;
+	size_t budget = 0;   // 0 : no budget
+};
+
+// figures reported by GL_NVX_gpu_memory_info or GL_ATI_meminfo, in bytes
+struct DriverMemoryInfo {
+	bool supported = false;
+	std::string source;
+	size_t dedicated = 0;      // NVX only
+	size_t freeMemory = 0;
+	size_t usedSinceInit = 0;  // to compare with getTotalGpuBytes()
+	size_t evicted = 0;        // NVX only
+	int evictionCount = 0;     // NVX only
+};
+
+/**
+ * Records every GPU allocation (and the CPU copies meshes keep) with its size and owner.
+ * Sizes are computed from the dimensions and formats we ask for : the driver may pad them,
+ * the NVX / ATI extensions give the real picture when the driver exposes them.
+ **/
+class MemoryTracker {
+
+	private:
+		mutable std::mutex m_mutex;
+		std::unordered_map<uint64_t, MemoryAllocation> m_allocations;
+		CategoryUsage m_usage[(int)MemoryCategory::COUNT];
+		size_t m_totalHighWater;
+		bool m_budgetWarned[(int)MemoryCategory::COUNT];
+
+		bool m_hasNvx;
+		bool m_hasAti;
+		size_t m_driverBaseline; // driver usage when init() ran, before our allocations
+
+		MemoryTracker();
+
+		void add(const MemoryAllocation &allocation);
+		void remove(MemoryKind kind, GLuint id);
+		size_t getTotalGpuBytesLocked() const;
+
+	public:
+		static MemoryTracker &get();
+
+		// GL thread, once the context is current : detects the driver extensions
+		void init();
+
+		void trackBuffer(GLuint id, size_t bytes, MemoryCategory category, const std::string &owner);
+		void trackTexture(GLuint id, int width, int height, GLenum internalFormat, int mipLevels, MemoryCategory category, const std::string &owner);
+		void trackRenderbuffer(GLuint id, int width, int height, GLenum internalFormat, const std::string &owner);
+		// keyed by the GL object the data belongs to (the mesh VBO)
+		void trackCpu(GLuint id, size_t bytes, MemoryCategory category, const std::string &owner);
+
+		void untrackBuffer(GLuint id);
+		void untrackTexture(GLuint id);
+		void untrackRenderbuffer(GLuint id);
+		void untrackCpu(GLuint id);
+
+		// budgets per level : exceeding one is reported once, loaders can check before allocating
+		void setBudget(MemoryCategory category, size_t bytes);
+		bool fitsBudget(MemoryCategory category, size_t bytes) const;
+
+		CategoryUsage getUsage(MemoryCategory category) const;
+		size_t getOwnerBytes(const std::string &owner) const;
+		size_t getTotalGpuBytes() const;
+
+		inline size_t getTotalHighWater() const {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			return m_totalHighWater;
+		}
+
+		DriverMemoryInfo queryDriver() const;
+
+		// everything above as JSON : totals per category, per owner, and every allocation
+		std::string toJson() const;
+		bool dumpJson(const std::string &path) const;
+
+		static const char *getCategoryName(MemoryCategory category);
+		static size_t getTextureBytes(int width, int height, GLenum internalFormat, int mipLevels);
+		static int getMipCount(int width, int height);
+
+};
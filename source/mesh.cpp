@@ -1,14 +1,82 @@
 #include "mesh.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures) {
+#include <cmath>
+#include <mutex>
+
+#include "memorytracker.h"
+#include "texturestreamer.h"
+
+// texture sets seen so far, the index is the material id
+static std::mutex materialMutex;
+static std::vector<std::vector<Texture>> materials;
+
+static unsigned int findMaterial(const std::vector<Texture> &textures) {
+
+	std::lock_guard<std::mutex> lock(materialMutex);
+
+	for (size_t i = 0; i < materials.size(); i++) {
+		const std::vector<Texture> &material = materials[i];
+		if (material.size() != textures.size()) {
+			continue;
+		}
+		bool same = true;
+		for (size_t j = 0; j < textures.size() && same; j++) {
+			same = material[j].id == textures[j].id && material[j].stream == textures[j].stream && material[j].type == textures[j].type;
+		}
+		if (same) {
+			return (unsigned int)i;
+		}
+	}
+
+	materials.push_back(textures);
+	return (unsigned int)(materials.size() - 1);
+}
+
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, std::vector<Meshlet> meshlets, const std::string &owner) {
 	this->vertices = vertices;
 	this->indices = indices;
 	this->textures = textures;
+	this->meshlets = meshlets;
+
+	if (this->meshlets.empty() && !this->vertices.empty()) {
+		BuildMeshlets(&this->vertices[0].position, sizeof(Vertex), this->vertices.size(), this->indices, this->meshlets);
+	}
+
+	boundsMin = glm::vec3(0.0f);
+	boundsMax = glm::vec3(0.0f);
+	if (!this->vertices.empty()) {
+		boundsMin = boundsMax = this->vertices[0].position;
+		for (size_t i = 1; i < this->vertices.size(); i++) {
+			boundsMin = glm::min(boundsMin, this->vertices[i].position);
+			boundsMax = glm::max(boundsMax, this->vertices[i].position);
+		}
+	}
+
+	// texel density, used to pick the mips to stream
+	float surfaceArea = 0.0f;
+	float uvArea = 0.0f;
+	for (size_t i = 0; i + 2 < this->indices.size(); i += 3) {
+		const Vertex &a = this->vertices[this->indices[i]];
+		const Vertex &b = this->vertices[this->indices[i + 1]];
+		const Vertex &c = this->vertices[this->indices[i + 2]];
+		surfaceArea += 0.5f * glm::length(glm::cross(b.position - a.position, c.position - a.position));
+		glm::vec2 uvB = b.texCoords - a.texCoords;
+		glm::vec2 uvC = c.texCoords - a.texCoords;
+		uvArea += 0.5f * std::abs(uvB.x * uvC.y - uvB.y * uvC.x);
+	}
+	uvDensity = uvArea > 0.0f ? std::sqrt(surfaceArea / uvArea) : 0.0f;
+
+	skinned = false;
+	for (size_t i = 0; i < this->vertices.size() && !skinned; i++) {
+		skinned = this->vertices[i].boneWeights[0] > 0;
+	}
+
+	materialId = findMaterial(this->textures);
 
-	setupMesh();
+	setupMesh(owner);
 }
 
-void Mesh::setupMesh() {
+void Mesh::setupMesh(const std::string &owner) {
 	
 	glGenVertexArrays(1, &VAO);
 	glGenBuffers(1, &VBO);
@@ -22,6 +90,12 @@ void Mesh::setupMesh() {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
 
+	MemoryTracker &memory = MemoryTracker::get();
+	memory.trackBuffer(VBO, vertices.size() * sizeof(Vertex), MemoryCategory::GEOMETRY, owner);
+	memory.trackBuffer(EBO, indices.size() * sizeof(unsigned int), MemoryCategory::GEOMETRY, owner);
+	// the copies kept for CPU side work (culling, picking)
+	memory.trackCpu(VBO, vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int) + meshlets.capacity() * sizeof(Meshlet), MemoryCategory::CPU_GEOMETRY, owner);
+
 	// vertex positions
 	glEnableVertexAttribArray(0);
 	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)0);
@@ -31,13 +105,33 @@ void Mesh::setupMesh() {
 	// vertex texture coords
 	glEnableVertexAttribArray(2);
 	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, texCoords));
+	// lightmap coords
+	glEnableVertexAttribArray(3);
+	glVertexAttribPointer(3, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void *)offsetof(Vertex, lightmapCoords));
+	// bone ids, integers in the shader
+	glEnableVertexAttribArray(4);
+	glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, sizeof(Vertex), (void *)offsetof(Vertex, boneIds));
+	// bone weights
+	glEnableVertexAttribArray(5);
+	glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void *)offsetof(Vertex, boneWeights));
 
 	glBindVertexArray(0); // Unbind current & bind to nothing
 
 }
 
 void Mesh::draw(Shader &shader) {
-	
+
+	bindTextures(shader);
+
+	// draw mesh
+	glBindVertexArray(VAO);
+	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0); // Unbind current & bind to nothing
+
+}
+
+void Mesh::bindTextures(Shader &shader) const {
+
 	unsigned int diffuseNr = 1;
 	unsigned int specularNr = 1;
 	unsigned int normalsNr = 1;
@@ -60,15 +154,14 @@ void Mesh::draw(Shader &shader) {
 		//}
 
 		shader.setFloat(("material." + name + number).c_str(), i);
-		glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		if (textures[i].stream != INVALID_STREAM) {
+			glBindTexture(GL_TEXTURE_2D, TextureStreamer::get().getId(textures[i].stream));
+		} else {
+			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		}
 
 	}
 
 	glActiveTexture(GL_TEXTURE0);
 
-	// draw mesh
-	glBindVertexArray(VAO);
-	glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-	glBindVertexArray(0); // Unbind current & bind to nothing
-
 }
\ No newline at end of file
@@ -7,17 +7,22 @@
 #include <glm\glm.hpp>
 
 #include "shader.h"
+#include "meshlet.h"
 
 struct Vertex {
 	glm::vec3 position;
 	glm::vec3 normals;
 	glm::vec2 texCoords;
+	glm::vec2 lightmapCoords; // atlas shared by the meshes of a model, (0, 0) when not baked
+	unsigned char boneIds[4];     // skeleton joints, weights of 0 for the unused ones
+	unsigned char boneWeights[4]; // unorm8, sum to 255 on skinned meshes
 };
 
 struct Texture {
 	GLuint id;
 	std::string type;
 	std::string path; // we store the path of the texture to compare with other textures
+	int stream = -1;  // TextureStreamer handle : the id changes as mips stream in and out
 };
 
 class Mesh {
@@ -27,13 +32,44 @@ public:
 	std::vector<Vertex> vertices;
 	std::vector<unsigned int> indices;
 	std::vector<Texture> textures;
+	// clusters culled on their own, their triangles are contiguous in indices
+	std::vector<Meshlet> meshlets;
 
-	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures);
+	// object space bounding box, computed from the vertices
+	glm::vec3 boundsMin;
+	glm::vec3 boundsMax;
+
+	// object space units per UV unit (sqrt of surface area / UV area), 0 without usable UVs
+	float uvDensity;
+
+	// some vertex has bone weights : bounds are the bind pose
+	bool skinned;
+
+	// owner : the asset the mesh comes from, for memory accounting
+	// meshlets are built here when the import did not provide them
+	Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<Texture> textures, std::vector<Meshlet> meshlets = std::vector<Meshlet>(), const std::string &owner = std::string());
 	void draw(Shader &shader);
 
+	// draw split in its state changes, for the RenderQueue
+	void bindTextures(Shader &shader) const;
+
+	inline GLuint getVAO() const {
+		return VAO;
+	}
+
+	inline GLsizei getIndexCount() const {
+		return (GLsizei)indices.size();
+	}
+
+	// meshes using the same textures share a material id
+	inline unsigned int getMaterialId() const {
+		return materialId;
+	}
+
 private:
 	// render data
 	GLuint VAO, VBO, EBO;
-	void setupMesh();
+	unsigned int materialId;
+	void setupMesh(const std::string &owner);
 
 };
\ No newline at end of file
@@ -0,0 +1,173 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+static inline const glm::vec3 &position(const glm::vec3 *positions, size_t stride, unsigned int index) {
+	return *(const glm::vec3 *)((const char *)positions + index * stride);
+}
+
+static Meshlet computeBounds(const glm::vec3 *positions, size_t stride, const unsigned int *indices, uint32_t firstIndex, uint32_t triangleCount, uint32_t vertexCount) {
+
+	Meshlet meshlet;
+	meshlet.firstIndex = firstIndex;
+	meshlet.triangleCount = triangleCount;
+	meshlet.vertexCount = vertexCount;
+
+	const unsigned int *triangles = indices + firstIndex;
+	size_t indexCount = (size_t)triangleCount * 3;
+
+	// sphere around the box : not the tightest, but cheap and never too small
+	glm::vec3 boundsMin = position(positions, stride, triangles[0]);
+	glm::vec3 boundsMax = boundsMin;
+	for (size_t i = 1; i < indexCount; i++) {
+		boundsMin = glm::min(boundsMin, position(positions, stride, triangles[i]));
+		boundsMax = glm::max(boundsMax, position(positions, stride, triangles[i]));
+	}
+	meshlet.center = (boundsMin + boundsMax) * 0.5f;
+	float radius2 = 0.0f;
+	for (size_t i = 0; i < indexCount; i++) {
+		glm::vec3 offset = position(positions, stride, triangles[i]) - meshlet.center;
+		radius2 = std::max(radius2, glm::dot(offset, offset));
+	}
+	meshlet.radius = std::sqrt(radius2);
+
+	// normal cone : axis is the mean of the unit normals, the cutoff comes from the normal farthest from it
+	std::vector<glm::vec3> normals;
+	normals.reserve(triangleCount);
+	glm::vec3 sum(0.0f);
+	for (size_t i = 0; i < indexCount; i += 3) {
+		const glm::vec3 &a = position(positions, stride, triangles[i]);
+		glm::vec3 normal = glm::cross(position(positions, stride, triangles[i + 1]) - a, position(positions, stride, triangles[i + 2]) - a);
+		float length = glm::length(normal);
+		if (length > 0.0f) {
+			normals.push_back(normal / length);
+			sum += normals.back();
+		}
+	}
+
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+
+	float sumLength = glm::length(sum);
+	if (sumLength > 1e-6f) {
+		meshlet.coneAxis = sum / sumLength;
+		float minDot = 1.0f;
+		for (size_t i = 0; i < normals.size(); i++) {
+			minDot = std::min(minDot, glm::dot(normals[i], meshlet.coneAxis));
+		}
+		// wider than ~85 degrees : the test would almost never pass
+		if (minDot > 0.1f) {
+			meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+	}
+
+	return meshlet;
+}
+
+void BuildMeshlets(const glm::vec3 *positions, size_t stride, size_t vertexCount, std::vector<unsigned int> &indices, std::vector<Meshlet> &meshlets) {
+
+	meshlets.clear();
+
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return;
+	}
+
+	// vertex to triangles adjacency
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacencyOffsets[indices[i] + 1]++;
+	}
+	for (size_t v = 0; v < vertexCount; v++) {
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+	}
+	std::vector<unsigned int> adjacency(triangleCount * 3);
+	std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++) {
+		adjacency[fill[indices[i]]++] = (unsigned int)(i / 3);
+	}
+
+	std::vector<unsigned int> ordered;
+	ordered.reserve(triangleCount * 3);
+
+	std::vector<char> emitted(triangleCount, 0);
+	std::vector<int> localIndex(vertexCount, -1); // slot of the vertex in the current meshlet
+	std::vector<unsigned int> meshletVertices;
+	std::vector<unsigned int> candidates;         // triangles touching the current meshlet
+	size_t seed = 0;
+	size_t emittedCount = 0;
+
+	while (emittedCount < triangleCount) {
+
+		uint32_t firstIndex = (uint32_t)ordered.size();
+		uint32_t meshletTriangles = 0;
+		meshletVertices.clear();
+		candidates.clear();
+
+		while (emitted[seed]) {
+			seed++;
+		}
+		size_t next = seed;
+
+		while (true) {
+
+			// take the triangle
+			emitted[next] = 1;
+			emittedCount++;
+			meshletTriangles++;
+			for (int corner = 0; corner < 3; corner++) {
+				unsigned int vertex = indices[next * 3 + corner];
+				ordered.push_back(vertex);
+				if (localIndex[vertex] < 0) {
+					localIndex[vertex] = (int)meshletVertices.size();
+					meshletVertices.push_back(vertex);
+					for (unsigned int a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++) {
+						if (!emitted[adjacency[a]]) {
+							candidates.push_back(adjacency[a]);
+						}
+					}
+				}
+			}
+
+			if (meshletTriangles == MESHLET_MAX_TRIANGLES) {
+				break;
+			}
+
+			// the neighbour adding the fewest new vertices keeps the meshlet compact
+			int best = -1;
+			int bestNewVertices = 4;
+			size_t kept = 0;
+			for (size_t c = 0; c < candidates.size(); c++) {
+				unsigned int triangle = candidates[c];
+				if (emitted[triangle]) {
+					continue;
+				}
+				candidates[kept++] = triangle;
+				int newVertices = 0;
+				for (int corner = 0; corner < 3; corner++) {
+					newVertices += localIndex[indices[triangle * 3 + corner]] < 0;
+				}
+				if (newVertices < bestNewVertices && meshletVertices.size() + newVertices <= MESHLET_MAX_VERTICES) {
+					best = (int)triangle;
+					bestNewVertices = newVertices;
+				}
+			}
+			candidates.resize(kept);
+
+			if (best < 0) {
+				break;
+			}
+			next = (size_t)best;
+		}
+
+		meshlets.push_back(computeBounds(positions, stride, ordered.data(), firstIndex, meshletTriangles, (uint32_t)meshletVertices.size()));
+
+		for (size_t v = 0; v < meshletVertices.size(); v++) {
+			localIndex[meshletVertices[v]] = -1;
+		}
+	}
+
+	// a trailing partial triangle is dropped, as the draw would ignore it anyway
+	indices.swap(ordered);
+}
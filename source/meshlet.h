@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// small enough for the post transform cache, large enough to keep the per cluster cost low
+const unsigned int MESHLET_MAX_VERTICES = 64;
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+/**
+ * Cluster of neighbouring triangles, culled as a whole.
+ * Seen from eye, every triangle of the meshlet faces away when
+ *   dot(center - eye, coneAxis) >= coneCutoff * length(center - eye) + radius
+ **/
+struct Meshlet {
+	glm::vec3 center;        // bounding sphere, object space
+	float radius;
+	glm::vec3 coneAxis;      // average triangle normal
+	float coneCutoff;        // sin of the normal cone half angle, 1 when the triangles face too many ways to ever cull
+	uint32_t firstIndex;     // the meshlet's triangles are contiguous in the mesh indices
+	uint32_t triangleCount;
+	uint32_t vertexCount;
+};
+
+// Splits indexed triangles into meshlets, growing each one through shared vertices.
+// indices are reordered meshlet by meshlet; counter clockwise triangles are front facing.
+void BuildMeshlets(const glm::vec3 *positions, size_t stride, size_t vertexCount, std::vector<unsigned int> &indices, std::vector<Meshlet> &meshlets);
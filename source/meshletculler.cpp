@@ -0,0 +1,143 @@
+#include "meshletculler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+MeshletCuller::MeshletCuller(JobSystem &jobs)
+	: m_eye(0.0f), m_ringBuffer(nullptr), m_count(0), m_overflows(0), m_meshlets(0), m_frustumCulled(0), m_backfaceCulled(0), m_triangles(0), m_drawnTriangles(0) {
+	m_scratch.resize(jobs.getThreadCount());
+	for (int i = 0; i < 6; i++) {
+		m_planes[i] = glm::vec4(0.0f);
+	}
+}
+
+void MeshletCuller::beginFrame(RingBuffer &ringBuffer, const glm::mat4 &viewProj, const glm::vec3 &eye) {
+
+	// rows of the matrix : left, right, bottom, top, near, far
+	for (int i = 0; i < 3; i++) {
+		glm::vec4 row(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+		glm::vec4 w(viewProj[0][3], viewProj[1][3], viewProj[2][3], viewProj[3][3]);
+		m_planes[i * 2] = w + row;
+		m_planes[i * 2 + 1] = w - row;
+	}
+	for (int i = 0; i < 6; i++) {
+		m_planes[i] /= glm::length(glm::vec3(m_planes[i]));
+	}
+	m_eye = eye;
+	m_ringBuffer = &ringBuffer;
+
+	m_count = 0;
+	m_overflows = 0;
+	m_meshlets = 0;
+	m_frustumCulled = 0;
+	m_backfaceCulled = 0;
+	m_triangles = 0;
+	m_drawnTriangles = 0;
+}
+
+bool MeshletCuller::cull(const Mesh &mesh, const glm::mat4 &world, GLintptr &commandOffset, uint32_t &commandCount) {
+
+	commandOffset = 0;
+	commandCount = 0;
+
+	// skinned clusters move away from their bind pose bounds and cones : drawn whole
+	const std::vector<Meshlet> &meshlets = mesh.meshlets;
+	if (meshlets.empty() || mesh.skinned) {
+		return true;
+	}
+
+	glm::mat3 linear(world);
+	float scaleX = glm::length(linear[0]);
+	float scaleY = glm::length(linear[1]);
+	float scaleZ = glm::length(linear[2]);
+	float maxScale = std::max(scaleX, std::max(scaleY, scaleZ));
+	float minScale = std::min(scaleX, std::min(scaleY, scaleZ));
+	bool testCones = maxScale - minScale <= maxScale * 1e-3f;
+
+	std::vector<DrawElementsIndirectCommand> &commands = m_scratch[JobSystem::getThreadIndex()];
+	commands.clear();
+
+	size_t frustumCulled = 0, backfaceCulled = 0, triangles = 0, drawnTriangles = 0;
+
+	for (size_t i = 0; i < meshlets.size(); i++) {
+
+		const Meshlet &meshlet = meshlets[i];
+		triangles += meshlet.triangleCount;
+
+		glm::vec3 center = glm::vec3(world * glm::vec4(meshlet.center, 1.0f));
+		float radius = meshlet.radius * maxScale;
+
+		bool inside = true;
+		for (int p = 0; p < 6 && inside; p++) {
+			inside = glm::dot(glm::vec3(m_planes[p]), center) + m_planes[p].w >= -radius;
+		}
+		if (!inside) {
+			frustumCulled++;
+			continue;
+		}
+
+		if (testCones && meshlet.coneCutoff < 1.0f) {
+			glm::vec3 axis = linear * meshlet.coneAxis / maxScale;
+			glm::vec3 toCenter = center - m_eye;
+			if (glm::dot(toCenter, axis) >= meshlet.coneCutoff * glm::length(toCenter) + radius) {
+				backfaceCulled++;
+				continue;
+			}
+		}
+
+		drawnTriangles += meshlet.triangleCount;
+
+		// survivors that follow each other in the index buffer share a draw
+		if (!commands.empty() && commands.back().firstIndex + commands.back().count == meshlet.firstIndex) {
+			commands.back().count += meshlet.triangleCount * 3;
+		} else {
+			DrawElementsIndirectCommand command;
+			command.count = meshlet.triangleCount * 3;
+			command.instanceCount = 1;
+			command.firstIndex = meshlet.firstIndex;
+			command.baseVertex = 0;
+			command.baseInstance = 0;
+			commands.push_back(command);
+		}
+	}
+
+	m_meshlets += meshlets.size();
+	m_frustumCulled += frustumCulled;
+	m_backfaceCulled += backfaceCulled;
+	m_triangles += triangles;
+	m_drawnTriangles += drawnTriangles;
+
+	if (commands.empty()) {
+		return false;
+	}
+
+	RingAllocation allocation;
+	if (m_ringBuffer) {
+		std::lock_guard<std::mutex> lock(m_ringMutex);
+		allocation = m_ringBuffer->allocate(commands.size() * sizeof(DrawElementsIndirectCommand), 16);
+	}
+	if (!allocation.data) {
+		// out of room : draw the whole mesh rather than nothing
+		m_overflows++;
+		return true;
+	}
+
+	std::memcpy(allocation.data, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand));
+	m_count += (uint32_t)commands.size();
+	commandOffset = allocation.offset;
+	commandCount = (uint32_t)commands.size();
+	return true;
+}
+
+MeshletStats MeshletCuller::getStats() const {
+	MeshletStats stats;
+	stats.meshlets = m_meshlets.load();
+	stats.frustumCulled = m_frustumCulled.load();
+	stats.backfaceCulled = m_backfaceCulled.load();
+	stats.triangles = m_triangles.load();
+	stats.drawnTriangles = m_drawnTriangles.load();
+	stats.commands = m_count.load();
+	stats.overflows = m_overflows.load();
+	return stats;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include "mesh.h"
+#include "ringbuffer.h"
+#include "jobsystem.h"
+
+// layout read by glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+struct MeshletStats {
+	size_t meshlets = 0;        // tested this frame
+	size_t frustumCulled = 0;
+	size_t backfaceCulled = 0;
+	size_t triangles = 0;       // in the tested meshlets
+	size_t drawnTriangles = 0;
+	size_t commands = 0;        // after merging neighbouring survivors
+	size_t overflows = 0;       // instances drawn whole because the ring buffer region was full
+};
+
+/**
+ * Per meshlet frustum and backface (normal cone) culling.
+ * Each call tests every meshlet of a mesh instance in one loop and writes indirect draws for the survivors,
+ * merging the ones that follow each other in the index buffer, into the frame's ring buffer region. Room is taken
+ * per call for the commands actually produced, not for the worst case of every meshlet of every instance.
+ * The cone test assumes uniform scale : instances with a non uniform one are only frustum culled.
+ **/
+class MeshletCuller {
+
+	private:
+		glm::vec4 m_planes[6]; // world space, pointing inside
+		glm::vec3 m_eye;
+
+		RingBuffer *m_ringBuffer;
+		std::mutex m_ringMutex; // cull() runs on the workers, the ring buffer is not thread safe
+		std::atomic<uint32_t> m_count;
+		std::atomic<size_t> m_overflows;
+
+		std::vector<std::vector<DrawElementsIndirectCommand>> m_scratch; // per thread
+
+		std::atomic<size_t> m_meshlets;
+		std::atomic<size_t> m_frustumCulled;
+		std::atomic<size_t> m_backfaceCulled;
+		std::atomic<size_t> m_triangles;
+		std::atomic<size_t> m_drawnTriangles;
+
+	public:
+		explicit MeshletCuller(JobSystem &jobs);
+
+		MeshletCuller(const MeshletCuller &) = delete;
+		MeshletCuller &operator=(const MeshletCuller &) = delete;
+
+		// GL thread : the commands of this frame go in ringBuffer's current region
+		void beginFrame(RingBuffer &ringBuffer, const glm::mat4 &viewProj, const glm::vec3 &eye);
+
+		// any thread : false when the whole instance is culled.
+		// commandOffset (in the ring buffer) and commandCount go to RenderQueue::push, a count of 0 draws the whole mesh
+		// (no meshlets, or no room left this frame)
+		bool cull(const Mesh &mesh, const glm::mat4 &world, GLintptr &commandOffset, uint32_t &commandCount);
+
+		MeshletStats getStats() const;
+
+};
@@ -1,50 +1,122 @@
 #include "model.h"
 
+#include "vfs.h"
+#include "memorytracker.h"
+#include "texturestreamer.h"
+
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 
 void Model::draw(Shader &shader) {
+
+	// still streaming in : draw nothing
+	if (!isReady()) {
+		return;
+	}
+
 	for (size_t i = 0; i < meshes.size(); i++) {
 		meshes[i].draw(shader);
 	}
 }
 
+void Model::getBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) const {
+
+	boundsMin = glm::vec3(0.0f);
+	boundsMax = glm::vec3(0.0f);
+
+	for (size_t i = 0; i < meshes.size(); i++) {
+		if (i == 0) {
+			boundsMin = meshes[i].boundsMin;
+			boundsMax = meshes[i].boundsMax;
+		} else {
+			boundsMin = glm::min(boundsMin, meshes[i].boundsMin);
+			boundsMax = glm::max(boundsMax, meshes[i].boundsMax);
+		}
+	}
+}
+
 
 void Model::loadModel(std::string path) {
 
+	state = LoadState::IMPORTING;
+
+	ModelData data;
+	if (!importModel(path, data)) {
+		state = LoadState::FAILED;
+		return;
+	}
+	directory = data.directory;
+	skeleton = std::move(data.skeleton);
+	clips = std::move(data.clips);
+
+	state = LoadState::UPLOADING;
+
+	for (size_t i = 0; i < data.textures.size(); i++) {
+		textures_loaded.push_back(CreateMaterialTexture(data.textures[i], data.directory, path));
+	}
+
+	for (size_t i = 0; i < data.meshes.size(); i++) {
+		std::vector<Texture> textures;
+		for (size_t j = 0; j < data.meshes[i].textures.size(); j++) {
+			textures.push_back(textures_loaded[data.meshes[i].textures[j]]);
+		}
+		meshes.push_back(Mesh(data.meshes[i].vertices, data.meshes[i].indices, textures, data.meshes[i].meshlets, path));
+	}
+
+	state = LoadState::READY;
+}
+
+
+bool Model::importModel(const std::string &path, ModelData &data) {
+
 	Assimp::Importer import;
-	const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate /*| aiProcess_FlipUVs*/);
+	import.SetIOHandler(new VfsIOSystem()); // owned by the importer
+	const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_LimitBoneWeights /*| aiProcess_FlipUVs*/);
 
 	if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
 		std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << std::endl;
-		return;
+		return false;
+	}
+	data.directory = path.substr(0, path.find_last_of('/'));
+
+	// before the meshes : their bone weights refer to the joint indices
+	if (ImportSkeleton(scene, data.skeleton)) {
+		ImportAnimations(scene, data.skeleton, data.clips);
 	}
-	directory = path.substr(0, path.find_last_of('/'));
 
-	processNode(scene->mRootNode, scene);
+	processNode(scene->mRootNode, scene, data);
+
+	// one atlas for the whole model
+	if (LightmapBaker::get().isEnabled()) {
+		LightmapBaker::get().packCharts(data.meshes);
+	}
+	return true;
 }
 
 
-void Model::processNode(aiNode *node, const aiScene *scene) {
+void Model::processNode(aiNode *node, const aiScene *scene, ModelData &data) {
 
 	// process all the node's meshes (if any)
 	for (size_t i = 0; i < node->mNumMeshes; i++) {
 		aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-		meshes.push_back(processMesh(mesh, scene));
+		data.meshes.push_back(processMesh(mesh, scene, data));
 	}
 
 	// then do the same for each of its children
 	for (size_t i = 0; i < node->mNumChildren; i++) {
-		processNode(node->mChildren[i], scene);
+		processNode(node->mChildren[i], scene, data);
 	}
 }
 
 
-Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
+MeshData Model::processMesh(aiMesh *mesh, const aiScene *scene, ModelData &data) {
+
+	MeshData meshData;
+	std::vector<Vertex> &vertices = meshData.vertices;
+	std::vector<unsigned int> &indices = meshData.indices;
+	std::vector<unsigned int> &textures = meshData.textures;
 
-	std::vector<Vertex> vertices;
-	std::vector<unsigned int> indices;
-	std::vector<Texture> textures;
+	vertices.reserve(mesh->mNumVertices);
 
 	for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
 
@@ -72,11 +144,22 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
 		} else {
 			vertex.texCoords = glm::vec2(0.0f, 0.0f);
 		}
+		vertex.lightmapCoords = glm::vec2(0.0f, 0.0f);
+		for (int j = 0; j < 4; j++) {
+			vertex.boneIds[j] = 0;
+			vertex.boneWeights[j] = 0;
+		}
 
 		vertices.push_back(vertex);
 	}
 
+	// process bone weights
+	if (mesh->HasBones() && !data.skeleton.empty()) {
+		processBones(mesh, data.skeleton, vertices);
+	}
+
 	// process indices
+	indices.reserve(mesh->mNumFaces * 3);
 	for (size_t i = 0; i < mesh->mNumFaces; i++) {
 		aiFace face = mesh->mFaces[i];
 		for (size_t j = 0; j < face.mNumIndices; j++) {
@@ -84,26 +167,92 @@ Mesh Model::processMesh(aiMesh *mesh, const aiScene *scene) {
 		}
 	}
 
+	// lightmap charts first : they duplicate the vertices on their borders
+	if (LightmapBaker::get().isEnabled()) {
+		LightmapBaker::get().buildCharts(vertices, indices, meshData.charts);
+	}
+
+	// meshlets on the importing thread, the upload only copies them
+	if (!vertices.empty()) {
+		BuildMeshlets(&vertices[0].position, sizeof(Vertex), vertices.size(), indices, meshData.meshlets);
+	}
+
 	// process material
 	if (mesh->mMaterialIndex >= 0) {
 		aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
 
-		std::vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+		std::vector<unsigned int> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", data);
 		textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
-		std::vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+		std::vector<unsigned int> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", data);
 		textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 
-		//std::vector<Texture> normalsMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normals");
+		//std::vector<unsigned int> normalsMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normals", data);
 		//textures.insert(textures.end(), normalsMaps.begin(), normalsMaps.end());
 	}
 
-	return Mesh(vertices, indices, textures);
+	return meshData;
 }
 
-std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName) {
+void Model::processBones(aiMesh *mesh, const Skeleton &skeleton, std::vector<Vertex> &vertices) {
 
-	std::vector<Texture> textures;
+	// the 4 heaviest influences of each vertex (aiProcess_LimitBoneWeights already keeps at most 4)
+	std::vector<float> weights(vertices.size() * 4, 0.0f);
+	std::vector<unsigned char> joints(vertices.size() * 4, 0);
+
+	for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+		const aiBone *bone = mesh->mBones[b];
+		int joint = skeleton.findJoint(bone->mName.C_Str());
+		if (joint < 0) {
+			continue;
+		}
+		for (unsigned int w = 0; w < bone->mNumWeights; w++) {
+			unsigned int vertex = bone->mWeights[w].mVertexId;
+			float weight = bone->mWeights[w].mWeight;
+			// replace the lightest slot
+			float *slots = &weights[vertex * 4];
+			int lightest = 0;
+			for (int j = 1; j < 4; j++) {
+				if (slots[j] < slots[lightest]) {
+					lightest = j;
+				}
+			}
+			if (weight > slots[lightest]) {
+				slots[lightest] = weight;
+				joints[vertex * 4 + lightest] = (unsigned char)joint;
+			}
+		}
+	}
+
+	// normalized, then quantized so the bytes still sum to 255
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const float *slots = &weights[i * 4];
+		float total = slots[0] + slots[1] + slots[2] + slots[3];
+		if (total <= 0.0f) {
+			continue;
+		}
+		int heaviest = 0;
+		int sum = 0;
+		for (int j = 0; j < 4; j++) {
+			vertices[i].boneIds[j] = joints[i * 4 + j];
+			vertices[i].boneWeights[j] = (unsigned char)(slots[j] / total * 255.0f + 0.5f);
+			sum += vertices[i].boneWeights[j];
+			if (slots[j] > slots[heaviest]) {
+				heaviest = j;
+			}
+		}
+		vertices[i].boneWeights[heaviest] = (unsigned char)(vertices[i].boneWeights[heaviest] + 255 - sum);
+		// slot 0 holds the heaviest : Mesh::skinned only looks at it
+		if (heaviest != 0) {
+			std::swap(vertices[i].boneIds[0], vertices[i].boneIds[heaviest]);
+			std::swap(vertices[i].boneWeights[0], vertices[i].boneWeights[heaviest]);
+		}
+	}
+}
+
+std::vector<unsigned int> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName, ModelData &data) {
+
+	std::vector<unsigned int> textures;
 
 	for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
 
@@ -111,23 +260,24 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType
 		mat->GetTexture(type, i, &str);
 		bool skip = false;
 
-		for (size_t j = 0; j < textures_loaded.size(); j++) {
+		for (size_t j = 0; j < data.textures.size(); j++) {
 
-			if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-				textures.push_back(textures_loaded[j]);
+			if (std::strcmp(data.textures[j].path.data(), str.C_Str()) == 0) {
+				textures.push_back((unsigned int)j);
 				skip = true;
 				break;
 			}
 
 		}
 
-		if (!skip) {   // if texture hasn't been loaded already, load it
-			Texture texture;
-			texture.id = TextureFromFile(str.C_Str(), directory);
+		if (!skip) {   // if texture hasn't been decoded already, decode it
+			TextureData texture;
+			DecodeTexture(str.C_Str(), data.directory, texture);
+			TextureStreamer::get().prepare(texture); // only the tail mips are kept when streaming
 			texture.type = typeName;
 			texture.path = str.C_Str();
-			textures.push_back(texture);
-			textures_loaded.push_back(texture); // add to loaded textures
+			textures.push_back((unsigned int)data.textures.size());
+			data.textures.push_back(texture); // add to decoded textures
 		}
 	}
 
@@ -136,80 +286,76 @@ std::vector<Texture> Model::loadMaterialTextures(aiMaterial *mat, aiTextureType
 }
 
 unsigned int TextureFromFile(const char *path, const std::string &directory) {
+	TextureData texture;
+	DecodeTexture(path, directory, texture);
+	return UploadTexture(texture);
+}
 
-	std::string filename = std::string(path);
-	filename = directory + '/' + filename;
+Texture CreateMaterialTexture(TextureData &data, const std::string &directory, const std::string &owner) {
 
-	unsigned int textureID;
-	{
+	Texture texture;
+	texture.type = data.type;
+	texture.path = data.path;
+	texture.id = 0;
 
-		std::string filename = std::string(path);
-		filename = directory + '/' + filename;
+	if (TextureStreamer::get().isEnabled()) {
+		texture.stream = TextureStreamer::get().create(data, directory, owner);
+	}
+	if (texture.stream == INVALID_STREAM) {
+		texture.id = UploadTexture(data, owner);
+	}
 
-		unsigned int textureID;
-		glGenTextures(1, &textureID);
+	return texture;
+}
 
-		int width, height, nrComponents;
-		unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+bool DecodeTexture(const char *path, const std::string &directory, TextureData &texture) {
 
-		if (data) {
-			GLenum format;
-			if (nrComponents == 1) {
-				format = GL_RED;
-			} else if (nrComponents == 3) {
-				format = GL_RGB;
-			} else if (nrComponents == 4) {
-				format = GL_RGBA;
-			}
+	std::string filename = std::string(path);
+	filename = directory + '/' + filename;
 
-			glBindTexture(GL_TEXTURE_2D, textureID);
-			glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-			glGenerateMipmap(GL_TEXTURE_2D);
+	FileData file;
+	if (Vfs::get().readFile(filename, file)) {
+		texture.pixels = stbi_load_from_memory((const stbi_uc *)file.data, (int)file.size, &texture.width, &texture.height, &texture.components, 0);
+	}
 
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	if (!texture.pixels) {
+		std::cout << "Texture failed to load at path: " << path << std::endl;
+		return false;
+	}
 
-			stbi_image_free(data);
+	return true;
+}
 
-		} else {
-			std::cout << "Texture failed to load at path: " << path << std::endl;
-			stbi_image_free(data);
-		}
+unsigned int UploadTexture(TextureData &texture, const std::string &owner) {
 
-		return textureID;
-	}
+	unsigned int textureID;
 	glGenTextures(1, &textureID);
 
-	int width, height, nrComponents;
-	unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-
-	if (data) {
+	if (texture.pixels) {
 		GLenum format;
-		if (nrComponents == 1) {
+		if (texture.components == 1) {
 			format = GL_RED;
-		} else if (nrComponents == 3) {
+		} else if (texture.components == 3) {
 			format = GL_RGB;
-		} else if (nrComponents == 4) {
+		} else {
 			format = GL_RGBA;
 		}
 
 		glBindTexture(GL_TEXTURE_2D, textureID);
-		glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+		glTexImage2D(GL_TEXTURE_2D, 0, format, texture.width, texture.height, 0, format, GL_UNSIGNED_BYTE, texture.pixels);
 		glGenerateMipmap(GL_TEXTURE_2D);
 
+		int mipLevels = MemoryTracker::getMipCount(texture.width, texture.height);
+		MemoryTracker::get().trackTexture(textureID, texture.width, texture.height, format, mipLevels, MemoryCategory::TEXTURE, owner.empty() ? texture.path : owner);
+
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-		stbi_image_free(data);
-
-	} else {
-		std::cout << "Texture failed to load at path: " << path << std::endl;
-		stbi_image_free(data);
+		stbi_image_free(texture.pixels);
+		texture.pixels = nullptr;
 	}
 
 	return textureID;
-}
\ No newline at end of file
+}
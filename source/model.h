@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <vector>
 #include <string>
 
@@ -8,26 +9,120 @@
 #include <assimp/postprocess.h>
 
 #include "mesh.h"
+#include "lightmapbaker.h"
+#include "skeleton.h"
+
+enum class LoadState {
+	QUEUED,
+	IMPORTING,
+	UPLOADING,
+	READY,
+	FAILED
+};
+
+// decoded image waiting to be uploaded, pixels are owned by stb_image
+struct TextureData {
+	std::string type;
+	std::string path;
+	int width = 0;       // of mip 0, even when pixels hold a smaller mip
+	int height = 0;
+	int components = 0;
+	int mip = 0;         // level held by pixels, > 0 once prepared for streaming
+	unsigned char *pixels = nullptr;
+
+	inline int getPixelWidth() const {
+		return width >> mip > 1 ? width >> mip : 1;
+	}
+
+	inline int getPixelHeight() const {
+		return height >> mip > 1 ? height >> mip : 1;
+	}
+};
+
+// mesh geometry waiting to be uploaded, textures are indices into ModelData::textures
+struct MeshData {
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	std::vector<unsigned int> textures;
+	std::vector<Meshlet> meshlets; // built with the import, indices already reordered
+	std::vector<LightmapChart> charts; // until the model's charts are packed
+};
+
+// everything the import produces before touching OpenGL : can be built on any thread
+struct ModelData {
+	std::string directory;
+	std::vector<TextureData> textures;
+	std::vector<MeshData> meshes;
+	Skeleton skeleton;                // empty without bones
+	std::vector<AnimationClip> clips; // sampled for the joints of skeleton
+};
 
 class Model {
 
+	friend class ModelLoader;
+
 public:
-	Model(char *path) {
+	// empty model, filled later by a ModelLoader
+	Model() : state(LoadState::QUEUED) {
+	}
+	// synchronous load : import and upload before returning
+	Model(char *path) : state(LoadState::QUEUED) {
 		loadModel(path);
 	}
 	void draw(Shader &shader);
 
+	inline LoadState getState() const {
+		return state.load();
+	}
+
+	inline bool isReady() const {
+		return state.load() == LoadState::READY;
+	}
+
+	inline const std::vector<Mesh> &getMeshes() const {
+		return meshes;
+	}
+
+	inline const Skeleton &getSkeleton() const {
+		return skeleton;
+	}
+
+	inline const std::vector<AnimationClip> &getClips() const {
+		return clips;
+	}
+
+	inline bool isSkinned() const {
+		return !skeleton.empty();
+	}
+
+	// union of the mesh bounding boxes, only meaningful once ready
+	void getBounds(glm::vec3 &boundsMin, glm::vec3 &boundsMax) const;
+
+	// CPU side import (Assimp parsing and texture decoding), no GL calls
+	static bool importModel(const std::string &path, ModelData &data);
+
 private:
 	// model data
 	std::vector<Texture> textures_loaded;
 	std::vector<Mesh> meshes;
 	std::string directory;
+	Skeleton skeleton;
+	std::vector<AnimationClip> clips;
+	std::atomic<LoadState> state;
 
 	void loadModel(std::string path);
-	void processNode(aiNode *node, const aiScene *scene);
-	Mesh processMesh(aiMesh *mesh, const aiScene *scene);
-	std::vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName);
+	static void processNode(aiNode *node, const aiScene *scene, ModelData &data);
+	static MeshData processMesh(aiMesh *mesh, const aiScene *scene, ModelData &data);
+	static void processBones(aiMesh *mesh, const Skeleton &skeleton, std::vector<Vertex> &vertices);
+	static std::vector<unsigned int> loadMaterialTextures(aiMaterial *mat, aiTextureType type, std::string typeName, ModelData &data);
 
 };
 
-unsigned int TextureFromFile(const char *path, const std::string &directory);
\ No newline at end of file
+unsigned int TextureFromFile(const char *path, const std::string &directory);
+
+// split version of TextureFromFile : decoding can run on any thread, uploading needs the GL context
+bool DecodeTexture(const char *path, const std::string &directory, TextureData &texture);
+unsigned int UploadTexture(TextureData &texture, const std::string &owner = std::string());
+
+// material texture of a model : streamed when the TextureStreamer is enabled, uploaded whole otherwise
+Texture CreateMaterialTexture(TextureData &texture, const std::string &directory, const std::string &owner);
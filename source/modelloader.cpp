@@ -0,0 +1,247 @@
+#include "modelloader.h"
+
+#include <chrono>
+
+#include "stb_image.h"
+#include "memorytracker.h"
+
+ModelLoader::ModelLoader(JobSystem &jobs, UploadBudget budget)
+	: m_jobs(jobs), m_budget(budget), m_pendingImports(0), m_pendingUploadBytes(0) {
+}
+
+ModelLoader::~ModelLoader() {
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_importDone.wait(lock, [this] { return m_pendingImports == 0; });
+
+	// decoded images that never reached the GPU
+	for (size_t i = 0; i < m_imported.size(); i++) {
+		for (size_t j = 0; j < m_imported[i].data->textures.size(); j++) {
+			stbi_image_free(m_imported[i].data->textures[j].pixels);
+		}
+	}
+	for (size_t i = 0; i < m_uploads.size(); i++) {
+		if (m_uploads[i].isTexture) {
+			stbi_image_free(m_uploads[i].data->textures[m_uploads[i].index].pixels);
+		}
+	}
+}
+
+ModelHandle ModelLoader::load(const std::string &path, LoadCallback callback) {
+
+	ModelHandle model = std::make_shared<Model>();
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingImports++;
+	}
+
+	m_jobs.submit([this, model, path, callback]() {
+
+		model->state = LoadState::IMPORTING;
+
+		ImportResult result;
+		result.model = model;
+		result.data = std::make_shared<ModelData>();
+		result.callback = callback;
+		result.path = path;
+		result.success = Model::importModel(path, *result.data);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_imported.push_back(result);
+		m_pendingImports--;
+		m_importDone.notify_all();
+	});
+
+	return model;
+}
+
+void ModelLoader::queueUploads(ImportResult &result) {
+
+	result.model->directory = result.data->directory;
+	result.model->skeleton = std::move(result.data->skeleton);
+	result.model->clips = std::move(result.data->clips);
+
+	// textures first : meshes reference them by index into textures_loaded
+	for (size_t i = 0; i < result.data->textures.size(); i++) {
+		const TextureData &texture = result.data->textures[i];
+
+		UploadItem item;
+		item.model = result.model;
+		item.data = result.data;
+		item.callback = result.callback;
+		item.path = result.path;
+		item.isTexture = true;
+		item.index = i;
+		item.bytes = (size_t)texture.getPixelWidth() * texture.getPixelHeight() * texture.components * 4 / 3; // + mip chain
+		m_pendingUploadBytes += item.bytes;
+		m_uploads.push_back(item);
+	}
+
+	for (size_t i = 0; i < result.data->meshes.size(); i++) {
+		const MeshData &mesh = result.data->meshes[i];
+
+		UploadItem item;
+		item.model = result.model;
+		item.data = result.data;
+		item.callback = result.callback;
+		item.path = result.path;
+		item.isTexture = false;
+		item.index = i;
+		item.bytes = mesh.vertices.size() * sizeof(Vertex) + mesh.indices.size() * sizeof(unsigned int);
+		m_pendingUploadBytes += item.bytes;
+		m_uploads.push_back(item);
+	}
+}
+
+bool ModelLoader::fitsMemoryBudget(const ModelData &data) const {
+
+	// what is already queued will land in the same categories
+	size_t textureBytes = 0;
+	size_t geometryBytes = 0;
+	for (size_t i = 0; i < m_uploads.size(); i++) {
+		if (m_uploads[i].isTexture) {
+			textureBytes += m_uploads[i].bytes;
+		} else {
+			geometryBytes += m_uploads[i].bytes;
+		}
+	}
+
+	for (size_t i = 0; i < data.textures.size(); i++) {
+		const TextureData &texture = data.textures[i];
+		GLenum format = texture.components == 1 ? GL_RED : (texture.components == 3 ? GL_RGB : GL_RGBA);
+		int mipLevels = MemoryTracker::getMipCount(texture.width, texture.height) - texture.mip;
+		textureBytes += MemoryTracker::getTextureBytes(texture.getPixelWidth(), texture.getPixelHeight(), format, mipLevels);
+	}
+	for (size_t i = 0; i < data.meshes.size(); i++) {
+		geometryBytes += data.meshes[i].vertices.size() * sizeof(Vertex) + data.meshes[i].indices.size() * sizeof(unsigned int);
+	}
+
+	MemoryTracker &memory = MemoryTracker::get();
+	return memory.fitsBudget(MemoryCategory::TEXTURE, textureBytes) && memory.fitsBudget(MemoryCategory::GEOMETRY, geometryBytes);
+}
+
+void ModelLoader::upload(UploadItem &item) {
+
+	Model &model = *item.model;
+	ModelData &data = *item.data;
+
+	if (item.isTexture) {
+		TextureData &textureData = data.textures[item.index];
+
+		model.textures_loaded.push_back(CreateMaterialTexture(textureData, data.directory, item.path));
+	} else {
+		MeshData &meshData = data.meshes[item.index];
+
+		std::vector<Texture> textures;
+		for (size_t j = 0; j < meshData.textures.size(); j++) {
+			textures.push_back(model.textures_loaded[meshData.textures[j]]);
+		}
+		model.meshes.push_back(Mesh(meshData.vertices, meshData.indices, textures, meshData.meshlets, item.path));
+
+		// the Mesh keeps its own copy
+		std::vector<Vertex>().swap(meshData.vertices);
+		std::vector<unsigned int>().swap(meshData.indices);
+		std::vector<Meshlet>().swap(meshData.meshlets);
+	}
+
+	m_pendingUploadBytes -= item.bytes;
+
+	bool last = !item.isTexture && item.index + 1 == data.meshes.size();
+	if (last) {
+		model.state = LoadState::READY;
+		if (item.callback) {
+			item.callback(item.path, LoadState::READY);
+		}
+	}
+}
+
+void ModelLoader::update() {
+
+	std::deque<ImportResult> imported;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		imported.swap(m_imported);
+	}
+
+	for (size_t i = 0; i < imported.size(); i++) {
+		ImportResult &result = imported[i];
+
+		if (!result.success) {
+			result.model->state = LoadState::FAILED;
+			if (result.callback) {
+				result.callback(result.path, LoadState::FAILED);
+			}
+			continue;
+		}
+
+		result.model->state = LoadState::UPLOADING;
+		if (result.callback) {
+			result.callback(result.path, LoadState::UPLOADING);
+		}
+
+		if (result.data->meshes.empty()) {
+			// nothing to draw, textures alone are not worth keeping
+			for (size_t j = 0; j < result.data->textures.size(); j++) {
+				stbi_image_free(result.data->textures[j].pixels);
+			}
+			result.model->state = LoadState::READY;
+			if (result.callback) {
+				result.callback(result.path, LoadState::READY);
+			}
+			continue;
+		}
+
+		// over the level memory budget : refuse the whole model rather than leaving it half uploaded
+		if (!fitsMemoryBudget(*result.data)) {
+			std::cout << "ERROR::MODEL_LOADER::MEMORY_BUDGET_EXCEEDED " << result.path << std::endl;
+			for (size_t j = 0; j < result.data->textures.size(); j++) {
+				stbi_image_free(result.data->textures[j].pixels);
+			}
+			result.model->state = LoadState::FAILED;
+			if (result.callback) {
+				result.callback(result.path, LoadState::FAILED);
+			}
+			continue;
+		}
+
+		queueUploads(result);
+	}
+
+	// upload within the budget, but always at least one item so a single big texture cannot block the queue
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	size_t uploadedBytes = 0;
+	size_t uploadedItems = 0;
+	float elapsed = 0.0f;
+
+	while (!m_uploads.empty()) {
+
+		UploadItem &item = m_uploads.front();
+		if (uploadedItems > 0 && (uploadedBytes + item.bytes > m_budget.maxBytes || elapsed >= m_budget.maxMilliseconds)) {
+			break;
+		}
+
+		upload(item);
+		uploadedBytes += item.bytes;
+		uploadedItems++;
+		m_uploads.pop_front();
+
+		elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	m_lastStats.uploadedBytes = uploadedBytes;
+	m_lastStats.uploadMilliseconds = elapsed;
+}
+
+LoaderStats ModelLoader::getStats() {
+
+	LoaderStats stats = m_lastStats;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		stats.pendingImports = m_pendingImports + m_imported.size();
+	}
+	stats.pendingUploads = m_uploads.size();
+	stats.pendingUploadBytes = m_pendingUploadBytes;
+
+	return stats;
+}
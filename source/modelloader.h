@@ -0,0 +1,99 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "model.h"
+#include "jobsystem.h"
+
+typedef std::shared_ptr<Model> ModelHandle;
+
+// called on the GL thread (from update) whenever a model changes state
+typedef std::function<void(const std::string &path, LoadState state)> LoadCallback;
+
+struct UploadBudget {
+	size_t maxBytes = 8 * 1024 * 1024;   // bytes sent to the GPU per frame
+	float maxMilliseconds = 2.0f;        // CPU time spent in GL upload calls per frame
+};
+
+struct LoaderStats {
+	size_t pendingImports = 0;   // queued or running on a worker
+	size_t pendingUploads = 0;   // textures and meshes waiting for the GL thread
+	size_t pendingUploadBytes = 0;
+	size_t uploadedBytes = 0;    // during the last update
+	float uploadMilliseconds = 0.0f;
+};
+
+/**
+ * Loads models without blocking the GL thread.
+ * load() returns an empty Model right away; Assimp parsing and texture decoding run on the JobSystem workers;
+ * update() then uploads the results a few textures / meshes at a time, within the per frame budget.
+ **/
+class ModelLoader {
+
+	private:
+		// one texture or one mesh to send to the GPU
+		struct UploadItem {
+			ModelHandle model;
+			std::shared_ptr<ModelData> data;
+			LoadCallback callback;
+			std::string path;
+			bool isTexture;
+			size_t index;
+			size_t bytes;
+		};
+
+		// imports finished by a worker, waiting to be split in upload items
+		struct ImportResult {
+			ModelHandle model;
+			std::shared_ptr<ModelData> data;
+			LoadCallback callback;
+			std::string path;
+			bool success;
+		};
+
+		JobSystem &m_jobs;
+		UploadBudget m_budget;
+
+		std::mutex m_mutex;
+		std::condition_variable m_importDone;
+		std::deque<ImportResult> m_imported;
+		size_t m_pendingImports;
+
+		// only touched by the GL thread
+		std::deque<UploadItem> m_uploads;
+		size_t m_pendingUploadBytes;
+		LoaderStats m_lastStats;
+
+		void queueUploads(ImportResult &result);
+		bool fitsMemoryBudget(const ModelData &data) const;
+		void upload(UploadItem &item);
+
+	public:
+		ModelLoader(JobSystem &jobs, UploadBudget budget = UploadBudget());
+		// waits for imports still running on the workers
+		~ModelLoader();
+
+		ModelLoader(const ModelLoader &) = delete;
+		ModelLoader &operator=(const ModelLoader &) = delete;
+
+		ModelHandle load(const std::string &path, LoadCallback callback = LoadCallback());
+
+		// GL thread, once per frame
+		void update();
+
+		LoaderStats getStats();
+
+		inline void setBudget(const UploadBudget &budget) {
+			m_budget = budget;
+		}
+
+		inline const UploadBudget &getBudget() const {
+			return m_budget;
+		}
+
+};
@@ -0,0 +1,311 @@
+#include "occlusionculler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <emmintrin.h>
+
+// occluder triangles are set up in chunks of this many indices
+const size_t OCCLUSION_SETUP_CHUNK = 3 * 1024;
+
+OcclusionCuller::OcclusionCuller(JobSystem &jobs, int width, int height)
+	: m_jobs(jobs), m_width(width), m_height(height), m_viewProj(1.0f), m_tested(0), m_culled(0) {
+
+	m_tilesX = m_width / OCCLUSION_TILE_WIDTH;
+	m_tilesY = m_height / OCCLUSION_TILE_HEIGHT;
+
+	m_depth = (float *)_mm_malloc(sizeof(float) * m_width * m_height, 16);
+	std::fill(m_depth, m_depth + m_width * m_height, 1.0f);
+	m_hiz.assign((m_width / OCCLUSION_HIZ_SIZE) * (m_height / OCCLUSION_HIZ_SIZE), 1.0f);
+
+	m_triangles.resize(m_jobs.getThreadCount());
+	m_bins.resize(m_jobs.getThreadCount());
+	for (size_t i = 0; i < m_bins.size(); i++) {
+		m_bins[i].resize(m_tilesX * m_tilesY);
+	}
+}
+
+OcclusionCuller::~OcclusionCuller() {
+	_mm_free(m_depth);
+}
+
+void OcclusionCuller::beginFrame(const glm::mat4 &viewProj) {
+	m_viewProj = viewProj;
+	m_occluders.clear();
+	m_stats = OcclusionStats();
+	m_tested = 0;
+	m_culled = 0;
+}
+
+void OcclusionCuller::addOccluder(const glm::vec3 *positions, size_t stride, const unsigned int *indices, size_t indexCount, const glm::mat4 &model) {
+
+	Occluder occluder;
+	occluder.positions = positions;
+	occluder.stride = stride;
+	occluder.indices = indices;
+	occluder.indexCount = indexCount;
+	occluder.model = m_viewProj * model; // stored directly as model-view-projection
+	m_occluders.push_back(occluder);
+
+	m_stats.occluderTriangles += indexCount / 3;
+}
+
+void OcclusionCuller::setupTriangles(const Occluder &occluder, size_t firstIndex, size_t endIndex, std::vector<ScreenTriangle> &out) {
+
+	const char *base = (const char *)occluder.positions;
+
+	for (size_t i = firstIndex; i + 2 < endIndex; i += 3) {
+
+		float x[3], y[3], z[3];
+		bool rejected = false;
+		bool allFar = true;
+
+		for (int v = 0; v < 3; v++) {
+			const glm::vec3 &p = *(const glm::vec3 *)(base + occluder.stride * occluder.indices[i + v]);
+			glm::vec4 clip = occluder.model * glm::vec4(p, 1.0f);
+
+			// crossing the near plane : skipping an occluder is always safe, only less efficient
+			if (clip.w <= 1e-5f || clip.z < -clip.w) {
+				rejected = true;
+				break;
+			}
+
+			float invW = 1.0f / clip.w;
+			x[v] = (clip.x * invW * 0.5f + 0.5f) * m_width;
+			y[v] = (clip.y * invW * 0.5f + 0.5f) * m_height;
+			z[v] = clip.z * invW * 0.5f + 0.5f;
+			allFar = allFar && z[v] > 1.0f;
+		}
+
+		if (rejected || allFar) {
+			continue;
+		}
+
+		// counter clockwise triangles face the camera, back faces and degenerate ones are skipped
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (area <= 0.0f) {
+			continue;
+		}
+
+		ScreenTriangle triangle;
+		triangle.minX = std::max(0, (int)std::floor(std::min(x[0], std::min(x[1], x[2]))));
+		triangle.minY = std::max(0, (int)std::floor(std::min(y[0], std::min(y[1], y[2]))));
+		triangle.maxX = std::min(m_width - 1, (int)std::ceil(std::max(x[0], std::max(x[1], x[2]))));
+		triangle.maxY = std::min(m_height - 1, (int)std::ceil(std::max(y[0], std::max(y[1], y[2]))));
+
+		if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY) {
+			continue;
+		}
+
+		// E(p) = A * px + B * py + C, positive inside for every edge
+		for (int e = 0; e < 3; e++) {
+			int a = e;
+			int b = (e + 1) % 3;
+			triangle.edgeA[e] = y[a] - y[b];
+			triangle.edgeB[e] = x[b] - x[a];
+			triangle.edgeC[e] = -(triangle.edgeA[e] * x[a] + triangle.edgeB[e] * y[a]);
+		}
+
+		// z / w is linear in screen space
+		triangle.depthX = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+		triangle.depthY = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+		triangle.depthC = z[0] - triangle.depthX * x[0] - triangle.depthY * y[0];
+
+		out.push_back(triangle);
+	}
+}
+
+void OcclusionCuller::rasterize() {
+
+	unsigned int threads = m_jobs.getThreadCount();
+	int tileCount = m_tilesX * m_tilesY;
+
+	for (unsigned int t = 0; t < threads; t++) {
+		m_triangles[t].clear();
+	}
+
+	// 1. transform and set up the occluder triangles
+	struct SetupWork {
+		size_t occluder;
+		size_t first;
+		size_t end;
+	};
+	std::vector<SetupWork> work;
+	for (size_t o = 0; o < m_occluders.size(); o++) {
+		for (size_t first = 0; first < m_occluders[o].indexCount; first += OCCLUSION_SETUP_CHUNK) {
+			SetupWork chunk = { o, first, std::min(first + OCCLUSION_SETUP_CHUNK, m_occluders[o].indexCount) };
+			work.push_back(chunk);
+		}
+	}
+
+	m_jobs.parallelFor(work.size(), 1, [this, &work](size_t begin, size_t end, unsigned int thread) {
+		for (size_t i = begin; i < end; i++) {
+			setupTriangles(m_occluders[work[i].occluder], work[i].first, work[i].end, m_triangles[thread]);
+		}
+	});
+
+	// 2. bin each thread's triangles into the tiles they overlap
+	m_jobs.parallelFor(threads, 1, [this, tileCount](size_t begin, size_t end, unsigned int) {
+		for (size_t t = begin; t < end; t++) {
+			std::vector<std::vector<unsigned int>> &bins = m_bins[t];
+			for (int tile = 0; tile < tileCount; tile++) {
+				bins[tile].clear();
+			}
+
+			for (size_t i = 0; i < m_triangles[t].size(); i++) {
+				const ScreenTriangle &triangle = m_triangles[t][i];
+				int tileMinX = triangle.minX / OCCLUSION_TILE_WIDTH;
+				int tileMaxX = triangle.maxX / OCCLUSION_TILE_WIDTH;
+				int tileMinY = triangle.minY / OCCLUSION_TILE_HEIGHT;
+				int tileMaxY = triangle.maxY / OCCLUSION_TILE_HEIGHT;
+
+				for (int ty = tileMinY; ty <= tileMaxY; ty++) {
+					for (int tx = tileMinX; tx <= tileMaxX; tx++) {
+						bins[ty * m_tilesX + tx].push_back((unsigned int)i);
+					}
+				}
+			}
+		}
+	});
+
+	for (unsigned int t = 0; t < threads; t++) {
+		m_stats.rasterizedTriangles += m_triangles[t].size();
+	}
+
+	// 3. rasterize the tiles, each one only touches its own pixels
+	m_jobs.parallelFor(tileCount, 1, [this](size_t begin, size_t end, unsigned int) {
+		for (size_t tile = begin; tile < end; tile++) {
+			rasterizeTile((int)tile);
+		}
+	});
+}
+
+void OcclusionCuller::rasterizeTile(int tile) {
+
+	int tileX0 = (tile % m_tilesX) * OCCLUSION_TILE_WIDTH;
+	int tileY0 = (tile / m_tilesX) * OCCLUSION_TILE_HEIGHT;
+	int tileX1 = tileX0 + OCCLUSION_TILE_WIDTH - 1;
+	int tileY1 = tileY0 + OCCLUSION_TILE_HEIGHT - 1;
+
+	for (int y = tileY0; y <= tileY1; y++) {
+		std::fill(m_depth + y * m_width + tileX0, m_depth + y * m_width + tileX1 + 1, 1.0f);
+	}
+
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+
+	for (size_t t = 0; t < m_bins.size(); t++) {
+		const std::vector<unsigned int> &bin = m_bins[t][tile];
+
+		for (size_t i = 0; i < bin.size(); i++) {
+			const ScreenTriangle &triangle = m_triangles[t][bin[i]];
+
+			// 4 pixels per step : start on a multiple of 4 so loads and stores stay aligned
+			int x0 = std::max(triangle.minX, tileX0) & ~3;
+			int x1 = std::min(triangle.maxX, tileX1);
+			int y0 = std::max(triangle.minY, tileY0);
+			int y1 = std::min(triangle.maxY, tileY1);
+
+			__m128 stepA0 = _mm_set1_ps(triangle.edgeA[0] * 4.0f);
+			__m128 stepA1 = _mm_set1_ps(triangle.edgeA[1] * 4.0f);
+			__m128 stepA2 = _mm_set1_ps(triangle.edgeA[2] * 4.0f);
+			__m128 stepZ = _mm_set1_ps(triangle.depthX * 4.0f);
+
+			__m128 xs = _mm_add_ps(_mm_set1_ps((float)x0), laneOffsets);
+
+			for (int y = y0; y <= y1; y++) {
+				float py = y + 0.5f;
+
+				__m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[0]), xs), _mm_set1_ps(triangle.edgeB[0] * py + triangle.edgeC[0]));
+				__m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[1]), xs), _mm_set1_ps(triangle.edgeB[1] * py + triangle.edgeC[1]));
+				__m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.edgeA[2]), xs), _mm_set1_ps(triangle.edgeB[2] * py + triangle.edgeC[2]));
+				__m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(triangle.depthX), xs), _mm_set1_ps(triangle.depthY * py + triangle.depthC));
+
+				float *row = m_depth + y * m_width;
+
+				for (int x = x0; x <= x1; x += 4) {
+					__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_cmpge_ps(e1, zero)), _mm_cmpge_ps(e2, zero));
+
+					if (_mm_movemask_ps(inside)) {
+						__m128 depth = _mm_load_ps(row + x);
+						__m128 nearest = _mm_min_ps(depth, z);
+						_mm_store_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, depth)));
+					}
+
+					e0 = _mm_add_ps(e0, stepA0);
+					e1 = _mm_add_ps(e1, stepA1);
+					e2 = _mm_add_ps(e2, stepA2);
+					z = _mm_add_ps(z, stepZ);
+				}
+			}
+		}
+	}
+
+	// hierarchical depth : farthest value of every block in the tile
+	int hizWidth = m_width / OCCLUSION_HIZ_SIZE;
+	for (int by = tileY0; by <= tileY1; by += OCCLUSION_HIZ_SIZE) {
+		for (int bx = tileX0; bx <= tileX1; bx += OCCLUSION_HIZ_SIZE) {
+			__m128 farthest = zero;
+			for (int y = by; y < by + OCCLUSION_HIZ_SIZE; y++) {
+				for (int x = bx; x < bx + OCCLUSION_HIZ_SIZE; x += 4) {
+					farthest = _mm_max_ps(farthest, _mm_load_ps(m_depth + y * m_width + x));
+				}
+			}
+			float lanes[4];
+			_mm_storeu_ps(lanes, farthest);
+			m_hiz[(by / OCCLUSION_HIZ_SIZE) * hizWidth + bx / OCCLUSION_HIZ_SIZE] = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+		}
+	}
+}
+
+bool OcclusionCuller::isVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &model) {
+
+	m_tested++;
+
+	glm::mat4 mvp = m_viewProj * model;
+
+	float minX = (float)m_width, minY = (float)m_height, maxX = 0.0f, maxY = 0.0f;
+	float nearest = 1.0f;
+
+	for (int corner = 0; corner < 8; corner++) {
+		glm::vec3 p((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z);
+		glm::vec4 clip = mvp * glm::vec4(p, 1.0f);
+
+		// the camera is inside or right next to the box
+		if (clip.w <= 1e-5f || clip.z < -clip.w) {
+			return true;
+		}
+
+		float invW = 1.0f / clip.w;
+		float x = (clip.x * invW * 0.5f + 0.5f) * m_width;
+		float y = (clip.y * invW * 0.5f + 0.5f) * m_height;
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * invW * 0.5f + 0.5f);
+	}
+
+	int blockMinX = std::max(0, (int)std::floor(minX)) / OCCLUSION_HIZ_SIZE;
+	int blockMinY = std::max(0, (int)std::floor(minY)) / OCCLUSION_HIZ_SIZE;
+	int blockMaxX = std::min(m_width - 1, (int)std::ceil(maxX)) / OCCLUSION_HIZ_SIZE;
+	int blockMaxY = std::min(m_height - 1, (int)std::ceil(maxY)) / OCCLUSION_HIZ_SIZE;
+
+	// outside the view : nothing to draw either
+	if (minX >= m_width || minY >= m_height || maxX < 0.0f || maxY < 0.0f) {
+		m_culled++;
+		return false;
+	}
+
+	int hizWidth = m_width / OCCLUSION_HIZ_SIZE;
+	for (int by = blockMinY; by <= blockMaxY; by++) {
+		for (int bx = blockMinX; bx <= blockMaxX; bx++) {
+			if (nearest <= m_hiz[by * hizWidth + bx]) {
+				return true;
+			}
+		}
+	}
+
+	m_culled++;
+	return false;
+}
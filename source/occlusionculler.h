@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "jobsystem.h"
+
+// The depth buffer is rasterized tile by tile on the workers
+const int OCCLUSION_TILE_WIDTH = 64;
+const int OCCLUSION_TILE_HEIGHT = 32;
+// Hierarchical depth : farthest depth of each block, what the bounding boxes are tested against
+const int OCCLUSION_HIZ_SIZE = 8;
+
+struct OcclusionStats {
+	size_t occluderTriangles = 0;   // submitted this frame
+	size_t rasterizedTriangles = 0; // after near plane, backface and screen rejection
+	size_t tested = 0;
+	size_t culled = 0;
+};
+
+/**
+ * Software occlusion culling, entirely on the CPU so it adds no GPU readback latency.
+ * A few occluder meshes are rasterized (4 pixels at a time with SSE) into a small depth buffer,
+ * then bounding boxes are tested against its hierarchical version before issuing their draws.
+ * Depth is z/w in [0, 1], 1 being far, and only the nearest occluder depth is kept.
+ **/
+class OcclusionCuller {
+
+	private:
+		struct Occluder {
+			const glm::vec3 *positions;
+			size_t stride;
+			const unsigned int *indices;
+			size_t indexCount;
+			glm::mat4 model;
+		};
+
+		// screen space triangle with its edge equations and depth plane already set up
+		struct ScreenTriangle {
+			float edgeA[3], edgeB[3], edgeC[3];
+			float depthX, depthY, depthC; // z = depthX * x + depthY * y + depthC
+			int minX, minY, maxX, maxY;
+		};
+
+		JobSystem &m_jobs;
+		int m_width;
+		int m_height;
+		int m_tilesX;
+		int m_tilesY;
+
+		glm::mat4 m_viewProj;
+		std::vector<Occluder> m_occluders;
+
+		std::vector<std::vector<ScreenTriangle>> m_triangles; // per thread
+		std::vector<std::vector<std::vector<unsigned int>>> m_bins; // per thread, per tile
+
+		float *m_depth;  // 16 bytes aligned for SSE loads
+		std::vector<float> m_hiz;
+
+		OcclusionStats m_stats;
+		// isVisible may run on several threads at once
+		std::atomic<size_t> m_tested;
+		std::atomic<size_t> m_culled;
+
+		void setupTriangles(const Occluder &occluder, size_t firstIndex, size_t endIndex, std::vector<ScreenTriangle> &out);
+		void rasterizeTile(int tile);
+
+	public:
+		// width must be a multiple of OCCLUSION_TILE_WIDTH, height of OCCLUSION_TILE_HEIGHT
+		OcclusionCuller(JobSystem &jobs, int width = 256, int height = 128);
+		~OcclusionCuller();
+
+		OcclusionCuller(const OcclusionCuller &) = delete;
+		OcclusionCuller &operator=(const OcclusionCuller &) = delete;
+
+		void beginFrame(const glm::mat4 &viewProj);
+
+		// occluders should be closed, low polygon meshes : back faces are skipped
+		// the data must stay alive until rasterize() returns
+		void addOccluder(const glm::vec3 *positions, size_t stride, const unsigned int *indices, size_t indexCount, const glm::mat4 &model);
+
+		void rasterize();
+
+		// false when the box is completely hidden behind the occluders
+		// thread safe once rasterize() returned
+		bool isVisible(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::mat4 &model);
+
+		inline OcclusionStats getStats() const {
+			OcclusionStats stats = m_stats;
+			stats.tested = m_tested.load();
+			stats.culled = m_culled.load();
+			return stats;
+		}
+
+		inline const float *getDepth() const {
+			return m_depth;
+		}
+
+};
@@ -0,0 +1,425 @@
+#include "packfile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX 1
+#endif
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "lz4.h"
+
+PackFile::PackFile()
+	: m_mapping(nullptr), m_mappingSize(0),
+#ifdef _WIN32
+	m_file(INVALID_HANDLE_VALUE), m_mappingHandle(nullptr),
+#else
+	m_file(-1),
+#endif
+	m_header(nullptr), m_entries(nullptr), m_chunks(nullptr), m_names(nullptr) {
+}
+
+PackFile::~PackFile() {
+	close();
+}
+
+void PackFile::close() {
+#ifdef _WIN32
+	if (m_mapping) {
+		UnmapViewOfFile(m_mapping);
+	}
+	if (m_mappingHandle) {
+		CloseHandle(m_mappingHandle);
+	}
+	if (m_file != INVALID_HANDLE_VALUE) {
+		CloseHandle(m_file);
+	}
+	m_file = INVALID_HANDLE_VALUE;
+	m_mappingHandle = nullptr;
+#else
+	if (m_mapping) {
+		munmap((void *)m_mapping, m_mappingSize);
+	}
+	if (m_file >= 0) {
+		::close(m_file);
+	}
+	m_file = -1;
+#endif
+	m_mapping = nullptr;
+	m_mappingSize = 0;
+	m_header = nullptr;
+}
+
+bool PackFile::open(const std::string &path) {
+
+	close();
+
+#ifdef _WIN32
+	m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (m_file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	GetFileSizeEx(m_file, &size);
+	m_mappingSize = (size_t)size.QuadPart;
+
+	m_mappingHandle = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_mappingHandle) {
+		m_mapping = (const char *)MapViewOfFile(m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	m_file = ::open(path.c_str(), O_RDONLY);
+	if (m_file < 0) {
+		return false;
+	}
+
+	struct stat status;
+	fstat(m_file, &status);
+	m_mappingSize = (size_t)status.st_size;
+
+	void *mapping = mmap(nullptr, m_mappingSize, PROT_READ, MAP_PRIVATE, m_file, 0);
+	m_mapping = mapping == MAP_FAILED ? nullptr : (const char *)mapping;
+#endif
+
+	if (!m_mapping || !validate()) {
+		std::cout << "ERROR::PACK::INVALID_PACK_FILE " << path << std::endl;
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+bool PackFile::validate() {
+
+	if (m_mappingSize < sizeof(PackHeader)) {
+		return false;
+	}
+
+	m_header = (const PackHeader *)m_mapping;
+	if (std::memcmp(m_header->magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0 || m_header->version != PACK_VERSION) {
+		return false;
+	}
+
+	if (m_header->entriesOffset + (uint64_t)m_header->entryCount * sizeof(PackEntry) > m_mappingSize
+		|| m_header->chunksOffset + (uint64_t)m_header->chunkCount * sizeof(PackChunk) > m_mappingSize
+		|| m_header->namesOffset + m_header->namesSize > m_mappingSize) {
+		return false;
+	}
+
+	m_entries = (const PackEntry *)(m_mapping + m_header->entriesOffset);
+	m_chunks = (const PackChunk *)(m_mapping + m_header->chunksOffset);
+	m_names = m_mapping + m_header->namesOffset;
+
+	for (uint32_t i = 0; i < m_header->chunkCount; i++) {
+		if (m_chunks[i].offset > m_mappingSize || m_chunks[i].compressedSize > m_mappingSize - m_chunks[i].offset) {
+			return false;
+		}
+	}
+
+	for (uint32_t i = 0; i < m_header->entryCount; i++) {
+		const PackEntry &entry = m_entries[i];
+		if ((uint64_t)entry.nameOffset + entry.nameLength > m_header->namesSize || (uint64_t)entry.firstChunk + entry.chunkCount > m_header->chunkCount) {
+			return false;
+		}
+
+		// chunks cover the entry exactly : full PACK_CHUNK_SIZE chunks, the last one holding the rest
+		uint64_t total = 0;
+		for (uint32_t c = 0; c < entry.chunkCount; c++) {
+			const PackChunk &chunk = m_chunks[entry.firstChunk + c];
+			if (c + 1 < entry.chunkCount && chunk.size != PACK_CHUNK_SIZE) {
+				return false;
+			}
+			total += chunk.size;
+		}
+		if (total != entry.size) {
+			return false;
+		}
+
+		// read() hands out the mapping itself : the chunks must follow each other, uncompressed, inside it
+		if ((entry.flags & PACK_ENTRY_STORED) && entry.chunkCount > 0) {
+			const PackChunk *chunks = m_chunks + entry.firstChunk;
+			for (uint32_t c = 0; c < entry.chunkCount; c++) {
+				if (chunks[c].compressedSize != chunks[c].size || (c > 0 && chunks[c].offset != chunks[c - 1].offset + chunks[c - 1].compressedSize)) {
+					return false;
+				}
+			}
+			if (chunks[0].offset + entry.size > m_mappingSize) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int PackFile::compare(const PackEntry &entry, const std::string &name) const {
+	size_t length = std::min<size_t>(entry.nameLength, name.size());
+	int result = std::memcmp(m_names + entry.nameOffset, name.data(), length);
+	if (result != 0) {
+		return result;
+	}
+	return entry.nameLength < name.size() ? -1 : (entry.nameLength > name.size() ? 1 : 0);
+}
+
+const PackEntry *PackFile::find(const std::string &name) const {
+
+	if (!m_header) {
+		return nullptr;
+	}
+
+	// entries are sorted by name
+	uint32_t low = 0;
+	uint32_t high = m_header->entryCount;
+	while (low < high) {
+		uint32_t middle = low + (high - low) / 2;
+		int order = compare(m_entries[middle], name);
+		if (order == 0) {
+			return &m_entries[middle];
+		}
+		if (order < 0) {
+			low = middle + 1;
+		} else {
+			high = middle;
+		}
+	}
+
+	return nullptr;
+}
+
+bool PackFile::read(const PackEntry &entry, FileData &file, JobSystem *jobs) const {
+
+	file.storage.clear();
+
+	if (entry.chunkCount == 0) {
+		file.data = m_mapping; // any valid pointer, size 0
+		file.size = 0;
+		return true;
+	}
+
+	// zero copy
+	if (entry.flags & PACK_ENTRY_STORED) {
+		file.data = m_mapping + m_chunks[entry.firstChunk].offset;
+		file.size = (size_t)entry.size;
+		return true;
+	}
+
+	file.storage.resize((size_t)entry.size);
+
+	std::atomic<bool> success(true);
+	auto decompress = [this, &entry, &file, &success](size_t begin, size_t end, unsigned int) {
+		for (size_t i = begin; i < end; i++) {
+			const PackChunk &chunk = m_chunks[entry.firstChunk + i];
+			char *destination = file.storage.data() + i * PACK_CHUNK_SIZE;
+
+			if (i * PACK_CHUNK_SIZE + chunk.size > file.storage.size()) {
+				success = false;
+			} else if (chunk.compressedSize == chunk.size) {
+				std::memcpy(destination, m_mapping + chunk.offset, chunk.size);
+			} else if (!Lz4Decompress(m_mapping + chunk.offset, chunk.compressedSize, destination, chunk.size)) {
+				success = false;
+			}
+		}
+	};
+
+	if (jobs && entry.chunkCount > 1) {
+		jobs->parallelFor(entry.chunkCount, 1, decompress);
+	} else {
+		decompress(0, entry.chunkCount, 0);
+	}
+
+	if (!success) {
+		std::cout << "ERROR::PACK::CORRUPTED_ENTRY " << getName(entry) << std::endl;
+		file.storage.clear();
+		file.data = nullptr;
+		file.size = 0;
+		return false;
+	}
+
+	file.data = file.storage.data();
+	file.size = file.storage.size();
+	return true;
+}
+
+
+static void listFiles(const std::string &directory, std::vector<std::string> &files) {
+
+#ifdef _WIN32
+	WIN32_FIND_DATAA found;
+	HANDLE search = FindFirstFileA((directory + "/*").c_str(), &found);
+	if (search == INVALID_HANDLE_VALUE) {
+		return;
+	}
+	do {
+		std::string name = found.cFileName;
+		if (name == "." || name == "..") {
+			continue;
+		}
+		if (found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) {
+			listFiles(directory + "/" + name, files);
+		} else {
+			files.push_back(directory + "/" + name);
+		}
+	} while (FindNextFileA(search, &found));
+	FindClose(search);
+#else
+	DIR *dir = opendir(directory.c_str());
+	if (!dir) {
+		return;
+	}
+	while (dirent *found = readdir(dir)) {
+		std::string name = found->d_name;
+		if (name == "." || name == "..") {
+			continue;
+		}
+		std::string path = directory + "/" + name;
+		struct stat status;
+		if (stat(path.c_str(), &status) != 0) {
+			continue;
+		}
+		if (S_ISDIR(status.st_mode)) {
+			listFiles(path, files);
+		} else {
+			files.push_back(path);
+		}
+	}
+	closedir(dir);
+#endif
+}
+
+bool BuildPack(const std::string &directory, const std::string &output, JobSystem &jobs) {
+
+	std::string root = directory;
+	std::replace(root.begin(), root.end(), '\\', '/');
+	while (!root.empty() && root.back() == '/') {
+		root.pop_back();
+	}
+
+	std::vector<std::string> files;
+	listFiles(root, files);
+	std::sort(files.begin(), files.end());
+
+	std::ofstream out(output, std::ios::binary);
+	if (!out) {
+		std::cout << "ERROR::PACK::CANNOT_WRITE " << output << std::endl;
+		return false;
+	}
+
+	PackHeader header;
+	std::memset(&header, 0, sizeof(header));
+	out.write((const char *)&header, sizeof(header)); // rewritten at the end
+
+	std::vector<PackEntry> entries;
+	std::vector<PackChunk> chunks;
+	std::string names;
+	uint64_t offset = sizeof(PackHeader);
+	uint64_t totalSize = 0;
+
+	for (size_t f = 0; f < files.size(); f++) {
+
+		std::ifstream in(files[f], std::ios::binary);
+		std::vector<char> content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		if (!in.good() && !in.eof()) {
+			std::cout << "ERROR::PACK::CANNOT_READ " << files[f] << std::endl;
+			return false;
+		}
+
+		size_t chunkCount = (content.size() + PACK_CHUNK_SIZE - 1) / PACK_CHUNK_SIZE;
+
+		// compress the chunks of this file in parallel, keep a chunk raw when LZ4 does not make it smaller
+		std::vector<std::vector<char>> compressed(chunkCount);
+		jobs.parallelFor(chunkCount, 1, [&content, &compressed](size_t begin, size_t end, unsigned int) {
+			for (size_t i = begin; i < end; i++) {
+				size_t start = i * PACK_CHUNK_SIZE;
+				size_t size = std::min<size_t>(PACK_CHUNK_SIZE, content.size() - start);
+
+				compressed[i].resize(Lz4CompressBound(size));
+				size_t compressedSize = Lz4Compress(content.data() + start, size, compressed[i].data(), compressed[i].size());
+				if (compressedSize == 0 || compressedSize >= size) {
+					compressed[i].clear();
+				} else {
+					compressed[i].resize(compressedSize);
+				}
+			}
+		});
+
+		PackEntry entry;
+		std::memset(&entry, 0, sizeof(entry));
+		entry.nameOffset = (uint32_t)names.size();
+		entry.nameLength = (uint32_t)files[f].size();
+		entry.size = content.size();
+		entry.firstChunk = (uint32_t)chunks.size();
+		entry.chunkCount = (uint32_t)chunkCount;
+		entry.flags = PACK_ENTRY_STORED;
+		names += files[f];
+
+		for (size_t i = 0; i < chunkCount; i++) {
+			size_t start = i * PACK_CHUNK_SIZE;
+			size_t size = std::min<size_t>(PACK_CHUNK_SIZE, content.size() - start);
+
+			PackChunk chunk;
+			chunk.offset = offset;
+			chunk.size = (uint32_t)size;
+
+			if (compressed[i].empty()) {
+				chunk.compressedSize = (uint32_t)size;
+				out.write(content.data() + start, size);
+			} else {
+				chunk.compressedSize = (uint32_t)compressed[i].size();
+				out.write(compressed[i].data(), compressed[i].size());
+				entry.flags &= ~PACK_ENTRY_STORED;
+			}
+
+			offset += chunk.compressedSize;
+			chunks.push_back(chunk);
+		}
+
+		entries.push_back(entry);
+		totalSize += content.size();
+	}
+
+	std::memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+	header.version = PACK_VERSION;
+	header.entryCount = (uint32_t)entries.size();
+	header.chunkCount = (uint32_t)chunks.size();
+
+	header.entriesOffset = offset;
+	out.write((const char *)entries.data(), entries.size() * sizeof(PackEntry));
+	offset += entries.size() * sizeof(PackEntry);
+
+	header.chunksOffset = offset;
+	out.write((const char *)chunks.data(), chunks.size() * sizeof(PackChunk));
+	offset += chunks.size() * sizeof(PackChunk);
+
+	header.namesOffset = offset;
+	header.namesSize = names.size();
+	out.write(names.data(), names.size());
+	offset += names.size();
+
+	out.seekp(0);
+	out.write((const char *)&header, sizeof(header));
+
+	if (!out) {
+		std::cout << "ERROR::PACK::CANNOT_WRITE " << output << std::endl;
+		return false;
+	}
+
+	std::cout << "Packed " << entries.size() << " files, " << totalSize << " bytes into " << offset << " bytes : " << output << std::endl;
+	return true;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "jobsystem.h"
+
+/**
+ * Pack file layout (little endian) :
+ *   PackHeader
+ *   chunk data        entries are split in PACK_CHUNK_SIZE chunks, each LZ4 compressed or stored as is
+ *   PackEntry[]       sorted by name, found with a binary search
+ *   PackChunk[]
+ *   names             not null terminated, referenced by offset / length
+ * The whole file is memory mapped : the table of contents is used in place, never parsed.
+ **/
+
+const char PACK_MAGIC[4] = { 'G', 'G', 'B', 'P' };
+const uint32_t PACK_VERSION = 1;
+const uint32_t PACK_CHUNK_SIZE = 256 * 1024;
+
+// every chunk of the entry is stored uncompressed and contiguous : it can be read in place
+const uint32_t PACK_ENTRY_STORED = 1;
+
+#pragma pack(push, 1)
+struct PackHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t chunkCount;
+	uint64_t entriesOffset;
+	uint64_t chunksOffset;
+	uint64_t namesOffset;
+	uint64_t namesSize;
+};
+
+struct PackEntry {
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint64_t size;
+	uint32_t firstChunk;
+	uint32_t chunkCount;
+	uint32_t flags;
+	uint32_t padding;
+};
+
+struct PackChunk {
+	uint64_t offset;
+	uint32_t compressedSize; // == size when the chunk is stored
+	uint32_t size;
+};
+#pragma pack(pop)
+
+// bytes of a file : either a view into a mapping, or a buffer we own
+struct FileData {
+	const char *data = nullptr;
+	size_t size = 0;
+	std::vector<char> storage;
+
+	FileData() = default;
+	FileData(FileData &&) = default;
+	FileData &operator=(FileData &&) = default;
+	FileData(const FileData &) = delete;
+	FileData &operator=(const FileData &) = delete;
+
+	inline bool isMapped() const {
+		return data != nullptr && storage.empty();
+	}
+};
+
+class PackFile {
+
+	private:
+		const char *m_mapping;
+		size_t m_mappingSize;
+#ifdef _WIN32
+		void *m_file;
+		void *m_mappingHandle;
+#else
+		int m_file;
+#endif
+		const PackHeader *m_header;
+		const PackEntry *m_entries;
+		const PackChunk *m_chunks;
+		const char *m_names;
+
+		void close();
+		bool validate();
+		int compare(const PackEntry &entry, const std::string &name) const;
+
+	public:
+		PackFile();
+		~PackFile();
+
+		PackFile(const PackFile &) = delete;
+		PackFile &operator=(const PackFile &) = delete;
+
+		bool open(const std::string &path);
+
+		// nullptr when the pack does not contain the file
+		const PackEntry *find(const std::string &name) const;
+
+		// stored entries are returned in place, compressed chunks are decompressed in parallel when jobs is given
+		bool read(const PackEntry &entry, FileData &file, JobSystem *jobs) const;
+
+		inline uint32_t getEntryCount() const {
+			return m_header ? m_header->entryCount : 0;
+		}
+
+		inline std::string getName(const PackEntry &entry) const {
+			return std::string(m_names + entry.nameOffset, entry.nameLength);
+		}
+
+};
+
+// pack every file under directory, names are stored relative to the working directory ("resources/shaders/...")
+bool BuildPack(const std::string &directory, const std::string &output, JobSystem &jobs);
@@ -0,0 +1,292 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+// below this, a single threaded std::sort is faster than dispatching the radix passes
+const size_t RADIX_SORT_THRESHOLD = 4096;
+const int RADIX_BITS = 8;
+const int RADIX_PASSES = 64 / RADIX_BITS;
+const int RADIX_BUCKETS = 1 << RADIX_BITS;
+
+RenderQueue::RenderQueue(JobSystem &jobs)
+	: m_jobs(jobs), m_view(1.0f), m_farPlane(100.0f), m_objectStride(0), m_objectCapacity(0) {
+	m_buckets.resize(m_jobs.getThreadCount());
+}
+
+uint16_t RenderQueue::registerProgram(Shader *shader) {
+
+	for (size_t i = 0; i < m_programs.size(); i++) {
+		if (m_programs[i] == shader) {
+			return (uint16_t)i;
+		}
+	}
+
+	if (m_programs.size() >= (1u << RENDER_KEY_PROGRAM_BITS)) {
+		std::cout << "ERROR::RENDER_QUEUE::TOO_MANY_PROGRAMS" << std::endl;
+		return 0;
+	}
+
+	m_programs.push_back(shader);
+	return (uint16_t)(m_programs.size() - 1);
+}
+
+bool RenderQueue::beginFrame(RingBuffer &ringBuffer, uint32_t objectCount, const glm::mat4 &view, float farPlane) {
+
+	for (size_t i = 0; i < m_buckets.size(); i++) {
+		m_buckets[i].clear();
+	}
+	m_items.clear();
+	m_stats = RenderQueueStats();
+
+	m_view = view;
+	m_farPlane = farPlane;
+
+	GLsizeiptr alignment = ringBuffer.getUniformAlignment();
+	m_objectStride = (sizeof(ObjectData) + alignment - 1) / alignment * alignment;
+	m_objects = ringBuffer.allocate(m_objectStride * std::max(objectCount, 1u), alignment);
+	m_objectCapacity = m_objects.data ? objectCount : 0;
+
+	if (!m_objects.data) {
+		std::cout << "ERROR::RENDER_QUEUE::RING_BUFFER_FULL" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+void RenderQueue::writeObject(uint32_t slot, const ObjectData &data) {
+	if (slot < m_objectCapacity) {
+		std::memcpy((char *)m_objects.data + slot * m_objectStride, &data, sizeof(ObjectData));
+	}
+}
+
+uint64_t RenderQueue::makeKey(RenderPass pass, uint16_t program, unsigned int material, float depth, GLuint vertexArray) {
+
+	const uint64_t depthMax = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+
+	uint64_t passBits = (uint64_t)pass;
+	uint64_t programBits = program & ((1u << RENDER_KEY_PROGRAM_BITS) - 1);
+	uint64_t materialBits = material & ((1u << RENDER_KEY_MATERIAL_BITS) - 1);
+	uint64_t depthBits = (uint64_t)(std::min(std::max(depth, 0.0f), 1.0f) * depthMax);
+	uint64_t geometryBits = vertexArray & ((1u << RENDER_KEY_GEOMETRY_BITS) - 1);
+
+	if (pass == RenderPass::TRANSPARENT_PASS) {
+		// back to front
+		return passBits << RENDER_KEY_PASS_SHIFT
+			| (depthMax - depthBits) << (RENDER_KEY_PASS_SHIFT - RENDER_KEY_DEPTH_BITS)
+			| programBits << (RENDER_KEY_GEOMETRY_BITS + RENDER_KEY_MATERIAL_BITS)
+			| materialBits << RENDER_KEY_GEOMETRY_BITS
+			| geometryBits;
+	}
+
+	return passBits << RENDER_KEY_PASS_SHIFT
+		| programBits << (RENDER_KEY_PASS_SHIFT - RENDER_KEY_PROGRAM_BITS)
+		| materialBits << (RENDER_KEY_GEOMETRY_BITS + RENDER_KEY_DEPTH_BITS)
+		| depthBits << RENDER_KEY_GEOMETRY_BITS
+		| geometryBits;
+}
+
+void RenderQueue::push(RenderPass pass, uint16_t program, const Mesh &mesh, uint32_t objectSlot, const glm::vec3 &center, GLintptr commandOffset, uint32_t commandCount) {
+
+	glm::vec4 viewPosition = m_view * glm::vec4(center, 1.0f);
+	float depth = -viewPosition.z / m_farPlane;
+
+	DrawItem item;
+	item.key = makeKey(pass, program, mesh.getMaterialId(), depth, mesh.getVAO());
+	item.mesh = &mesh;
+	item.objectSlot = objectSlot;
+	item.commandOffset = (uint32_t)commandOffset;
+	item.commandCount = commandCount;
+	item.program = program;
+	item.padding = 0;
+
+	m_buckets[JobSystem::getThreadIndex()].push_back(item);
+}
+
+void RenderQueue::sort() {
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	size_t count = 0;
+	for (size_t i = 0; i < m_buckets.size(); i++) {
+		count += m_buckets[i].size();
+	}
+
+	m_items.resize(count);
+	size_t offset = 0;
+	for (size_t i = 0; i < m_buckets.size(); i++) {
+		std::copy(m_buckets[i].begin(), m_buckets[i].end(), m_items.begin() + offset);
+		offset += m_buckets[i].size();
+	}
+
+	if (count < RADIX_SORT_THRESHOLD) {
+		std::sort(m_items.begin(), m_items.end(), [](const DrawItem &a, const DrawItem &b) {
+			return a.key < b.key;
+		});
+	} else {
+		radixSort();
+	}
+
+	m_stats.items = count;
+	m_stats.sortMilliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void RenderQueue::radixSort() {
+
+	size_t count = m_items.size();
+	size_t chunkCount = m_jobs.getThreadCount();
+	size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+	m_scratch.resize(count);
+
+	// histograms of every digit in one read : digits every key shares (pass, program...) need no pass
+	std::vector<size_t> digitCounts(chunkCount * RADIX_PASSES * RADIX_BUCKETS, 0);
+	m_jobs.parallelFor(chunkCount, 1, [&](size_t begin, size_t end, unsigned int) {
+		for (size_t chunk = begin; chunk < end; chunk++) {
+			size_t *counts = &digitCounts[chunk * RADIX_PASSES * RADIX_BUCKETS];
+			size_t last = std::min(count, (chunk + 1) * chunkSize);
+			for (size_t i = chunk * chunkSize; i < last; i++) {
+				uint64_t key = m_items[i].key;
+				for (int pass = 0; pass < RADIX_PASSES; pass++) {
+					counts[pass * RADIX_BUCKETS + ((key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1))]++;
+				}
+			}
+		}
+	});
+
+	std::vector<size_t> offsets(chunkCount * RADIX_BUCKETS);
+	DrawItem *src = m_items.data();
+	DrawItem *dst = m_scratch.data();
+
+	for (int pass = 0; pass < RADIX_PASSES; pass++) {
+
+		bool constant = false;
+		for (int digit = 0; digit < RADIX_BUCKETS && !constant; digit++) {
+			size_t total = 0;
+			for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+				total += digitCounts[(chunk * RADIX_PASSES + pass) * RADIX_BUCKETS + digit];
+			}
+			constant = total == count;
+		}
+		if (constant) {
+			continue;
+		}
+
+		int shift = pass * RADIX_BITS;
+
+		// per chunk histogram of the current order
+		m_jobs.parallelFor(chunkCount, 1, [&](size_t begin, size_t end, unsigned int) {
+			for (size_t chunk = begin; chunk < end; chunk++) {
+				size_t *counts = &offsets[chunk * RADIX_BUCKETS];
+				std::fill(counts, counts + RADIX_BUCKETS, 0);
+				size_t last = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < last; i++) {
+					counts[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++;
+				}
+			}
+		});
+
+		// digit major, then chunk : keeps the scatter stable
+		size_t sum = 0;
+		for (int digit = 0; digit < RADIX_BUCKETS; digit++) {
+			for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+				size_t value = offsets[chunk * RADIX_BUCKETS + digit];
+				offsets[chunk * RADIX_BUCKETS + digit] = sum;
+				sum += value;
+			}
+		}
+
+		m_jobs.parallelFor(chunkCount, 1, [&](size_t begin, size_t end, unsigned int) {
+			for (size_t chunk = begin; chunk < end; chunk++) {
+				size_t *position = &offsets[chunk * RADIX_BUCKETS];
+				size_t last = std::min(count, (chunk + 1) * chunkSize);
+				for (size_t i = chunk * chunkSize; i < last; i++) {
+					dst[position[(src[i].key >> shift) & (RADIX_BUCKETS - 1)]++] = src[i];
+				}
+			}
+		});
+
+		std::swap(src, dst);
+		m_stats.sortPasses++;
+	}
+
+	if (src != m_items.data()) {
+		m_items.swap(m_scratch);
+	}
+}
+
+void RenderQueue::submit(RingBuffer &ringBuffer) {
+
+	int currentPass = -1;
+	int currentProgram = -1;
+	unsigned int currentMaterial = UINT_MAX;
+	GLuint currentVertexArray = 0;
+	uint32_t currentSlot = UINT32_MAX;
+	bool indirectBound = false;
+
+	for (size_t i = 0; i < m_items.size(); i++) {
+
+		const DrawItem &item = m_items[i];
+		const Mesh &mesh = *item.mesh;
+
+		int pass = (int)(item.key >> RENDER_KEY_PASS_SHIFT);
+		if (pass != currentPass) {
+			if (pass == (int)RenderPass::TRANSPARENT_PASS) {
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				glDepthMask(GL_FALSE);
+			}
+			currentPass = pass;
+		}
+
+		if (item.program != currentProgram) {
+			m_programs[item.program]->use();
+			currentProgram = item.program;
+			// sampler uniforms belong to the program
+			currentMaterial = UINT_MAX;
+			m_stats.programChanges++;
+		}
+
+		if (mesh.getMaterialId() != currentMaterial) {
+			mesh.bindTextures(*m_programs[item.program]);
+			currentMaterial = mesh.getMaterialId();
+			m_stats.materialChanges++;
+		}
+
+		if (mesh.getVAO() != currentVertexArray) {
+			glBindVertexArray(mesh.getVAO());
+			currentVertexArray = mesh.getVAO();
+			m_stats.vertexArrayChanges++;
+		}
+
+		if (item.objectSlot != currentSlot && item.objectSlot < m_objectCapacity) {
+			glBindBufferRange(GL_UNIFORM_BUFFER, OBJECT_BLOCK_BINDING, ringBuffer.getBuffer(),
+				m_objects.offset + item.objectSlot * m_objectStride, sizeof(ObjectData));
+			currentSlot = item.objectSlot;
+			m_stats.objectBinds++;
+		}
+
+		if (item.commandCount > 0) {
+			if (!indirectBound) {
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, ringBuffer.getBuffer());
+				indirectBound = true;
+			}
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void *)(uintptr_t)item.commandOffset, item.commandCount, 0);
+			m_stats.indirectDraws++;
+		} else {
+			glDrawElements(GL_TRIANGLES, mesh.getIndexCount(), GL_UNSIGNED_INT, 0);
+		}
+	}
+
+	glBindVertexArray(0);
+	if (indirectBound) {
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+	}
+
+	if (currentPass == (int)RenderPass::TRANSPARENT_PASS) {
+		glDisable(GL_BLEND);
+		glDepthMask(GL_TRUE);
+	}
+}
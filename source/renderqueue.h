@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include "mesh.h"
+#include "shader.h"
+#include "shaderdata.h"
+#include "ringbuffer.h"
+#include "jobsystem.h"
+
+enum class RenderPass {
+	OPAQUE_PASS = 0,
+	TRANSPARENT_PASS = 1
+};
+
+/**
+ * Sort key, most significant bits first :
+ *   opaque       pass(4) | program(8) | material(16) | depth(24, front to back) | geometry(12)
+ *   transparent  pass(4) | depth(24, back to front) | program(8) | material(16) | geometry(12)
+ * Opaque draws change state as little as possible and go front to back inside a state for early-Z;
+ * transparent ones must blend in order, so their depth comes first.
+ **/
+const int RENDER_KEY_PASS_SHIFT = 60;
+const int RENDER_KEY_GEOMETRY_BITS = 12;
+const int RENDER_KEY_MATERIAL_BITS = 16;
+const int RENDER_KEY_PROGRAM_BITS = 8;
+const int RENDER_KEY_DEPTH_BITS = 24;
+
+struct DrawItem {
+	uint64_t key;
+	const Mesh *mesh;
+	uint32_t objectSlot;    // ObjectData written with writeObject
+	uint32_t commandOffset; // indirect draws in the ring buffer (MeshletCuller)
+	uint32_t commandCount;  // 0 : the whole mesh
+	uint16_t program;       // index returned by registerProgram
+	uint16_t padding;
+};
+
+struct RenderQueueStats {
+	size_t items = 0;
+	size_t programChanges = 0;
+	size_t materialChanges = 0;
+	size_t vertexArrayChanges = 0;
+	size_t objectBinds = 0;
+	size_t indirectDraws = 0;      // glMultiDrawElementsIndirect calls, for the meshlet culled meshes
+	unsigned int sortPasses = 0;   // radix passes actually run, constant digits are skipped
+	float sortMilliseconds = 0.0f;
+};
+
+/**
+ * Per frame list of draws.
+ * Items are pushed from any thread into that thread's bucket (JobSystem::getThreadIndex()), merged and radix
+ * sorted on the workers, then submitted by the GL thread, skipping the program / texture / VAO / object binds
+ * that did not change since the previous draw.
+ **/
+class RenderQueue {
+
+	private:
+		JobSystem &m_jobs;
+		std::vector<Shader *> m_programs;
+
+		std::vector<std::vector<DrawItem>> m_buckets; // per thread
+		std::vector<DrawItem> m_items;
+		std::vector<DrawItem> m_scratch;
+
+		glm::mat4 m_view;
+		float m_farPlane;
+
+		// one ObjectData per object slot, in the frame's ring buffer region
+		RingAllocation m_objects;
+		GLsizeiptr m_objectStride;
+		uint32_t m_objectCapacity;
+
+		RenderQueueStats m_stats;
+
+		void radixSort();
+
+	public:
+		explicit RenderQueue(JobSystem &jobs);
+
+		RenderQueue(const RenderQueue &) = delete;
+		RenderQueue &operator=(const RenderQueue &) = delete;
+
+		// the index goes in the sort key : at most 2^RENDER_KEY_PROGRAM_BITS programs
+		uint16_t registerProgram(Shader *shader);
+
+		// GL thread : clears the buckets and reserves objectCount ObjectData slots in the ring buffer
+		bool beginFrame(RingBuffer &ringBuffer, uint32_t objectCount, const glm::mat4 &view, float farPlane);
+
+		// any thread, one slot per object
+		void writeObject(uint32_t slot, const ObjectData &data);
+
+		// any thread : center is the world space position used for the depth bucket
+		// commandCount indirect draws at commandOffset in the ring buffer replace the whole mesh draw
+		void push(RenderPass pass, uint16_t program, const Mesh &mesh, uint32_t objectSlot, const glm::vec3 &center, GLintptr commandOffset = 0, uint32_t commandCount = 0);
+
+		static uint64_t makeKey(RenderPass pass, uint16_t program, unsigned int material, float depth, GLuint vertexArray);
+
+		// merge the buckets and sort, on the workers
+		void sort();
+
+		// GL thread
+		void submit(RingBuffer &ringBuffer);
+
+		inline const std::vector<DrawItem> &getItems() const {
+			return m_items;
+		}
+
+		inline const RenderQueueStats &getStats() const {
+			return m_stats;
+		}
+
+};
@@ -0,0 +1,199 @@
+#include "renderscaler.h"
+
+#include <cmath>
+
+#include "memorytracker.h"
+
+RenderScaler::RenderScaler(int windowWidth, int windowHeight, RenderScaleSettings settings)
+	: m_settings(settings), m_windowWidth(windowWidth), m_windowHeight(windowHeight), m_targetWidth(0), m_targetHeight(0),
+	m_scale(settings.maxScale), m_gpuTime(0.0f), m_smoothedGpuTime(0.0f), m_overFrames(0), m_underFrames(0), m_cooldown(0),
+	m_fbo(0), m_colorTexture(0), m_depthRenderbuffer(0), m_frameIndex(0),
+	m_upscaleShader("resources/shaders/upscale.vert", "resources/shaders/upscale.frag") {
+
+	glGenQueries(GPU_TIMER_QUERIES, m_queries);
+	for (int i = 0; i < GPU_TIMER_QUERIES; i++) {
+		m_queryIssued[i] = false;
+	}
+
+	glGenVertexArrays(1, &m_emptyVAO);
+
+	createTarget();
+}
+
+RenderScaler::~RenderScaler() {
+	destroyTarget();
+	glDeleteVertexArrays(1, &m_emptyVAO);
+	glDeleteQueries(GPU_TIMER_QUERIES, m_queries);
+	glDeleteProgram(m_upscaleShader.ID);
+}
+
+void RenderScaler::createTarget() {
+
+	m_targetWidth = std::max(1, (int)std::ceil(m_windowWidth * m_settings.maxScale));
+	m_targetHeight = std::max(1, (int)std::ceil(m_windowHeight * m_settings.maxScale));
+
+	glGenFramebuffers(1, &m_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+
+	// color : sampled by the upscale pass, so it needs filtering but no mipmaps
+	glGenTextures(1, &m_colorTexture);
+	glBindTexture(GL_TEXTURE_2D, m_colorTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_targetWidth, m_targetHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_colorTexture, 0);
+
+	// depth : never sampled, a renderbuffer is enough
+	glGenRenderbuffers(1, &m_depthRenderbuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, m_depthRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, m_targetWidth, m_targetHeight);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_depthRenderbuffer);
+
+	MemoryTracker::get().trackTexture(m_colorTexture, m_targetWidth, m_targetHeight, GL_RGBA8, 1, MemoryCategory::RENDER_TARGET, "RenderScaler");
+	MemoryTracker::get().trackRenderbuffer(m_depthRenderbuffer, m_targetWidth, m_targetHeight, GL_DEPTH24_STENCIL8, "RenderScaler");
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR::FRAMEBUFFER::RENDER_SCALER_TARGET_INCOMPLETE" << std::endl;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void RenderScaler::destroyTarget() {
+	MemoryTracker::get().untrackTexture(m_colorTexture);
+	MemoryTracker::get().untrackRenderbuffer(m_depthRenderbuffer);
+	glDeleteFramebuffers(1, &m_fbo);
+	glDeleteTextures(1, &m_colorTexture);
+	glDeleteRenderbuffers(1, &m_depthRenderbuffer);
+	m_fbo = m_colorTexture = m_depthRenderbuffer = 0;
+}
+
+void RenderScaler::resize(int windowWidth, int windowHeight) {
+
+	// minimized window : keep the previous target
+	if (windowWidth <= 0 || windowHeight <= 0) {
+		return;
+	}
+
+	if (windowWidth == m_windowWidth && windowHeight == m_windowHeight) {
+		return;
+	}
+
+	m_windowWidth = windowWidth;
+	m_windowHeight = windowHeight;
+
+	destroyTarget();
+	createTarget();
+}
+
+void RenderScaler::readTimers() {
+
+	// the query we are about to reuse was issued GPU_TIMER_QUERIES frames ago
+	unsigned int slot = m_frameIndex % GPU_TIMER_QUERIES;
+	if (!m_queryIssued[slot]) {
+		return;
+	}
+
+	GLint available = GL_FALSE;
+	glGetQueryObjectiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available) {
+		// the GPU is more than GPU_TIMER_QUERIES frames behind : do not wait, just lose this sample
+		return;
+	}
+
+	GLuint64 elapsed = 0;
+	glGetQueryObjectui64v(m_queries[slot], GL_QUERY_RESULT, &elapsed);
+	m_gpuTime = elapsed / 1000000.0f; // nanoseconds to milliseconds
+
+	if (m_smoothedGpuTime == 0.0f) {
+		m_smoothedGpuTime = m_gpuTime;
+	} else {
+		m_smoothedGpuTime += (m_gpuTime - m_smoothedGpuTime) * 0.1f;
+	}
+
+	updateScale();
+}
+
+void RenderScaler::updateScale() {
+
+	if (m_cooldown > 0) {
+		m_cooldown--;
+		return;
+	}
+
+	float ratio = m_smoothedGpuTime / m_settings.targetFrameTime;
+
+	// hysteresis : only react when the ratio stays outside the dead zone for a while
+	if (ratio > m_settings.overBudget) {
+		m_overFrames++;
+		m_underFrames = 0;
+	} else if (ratio < m_settings.underBudget) {
+		m_underFrames++;
+		m_overFrames = 0;
+	} else {
+		m_overFrames = 0;
+		m_underFrames = 0;
+		return;
+	}
+
+	if (m_overFrames < m_settings.settleFrames && m_underFrames < m_settings.settleFrames) {
+		return;
+	}
+
+	// GPU time is roughly proportional to the pixel count, i.e. to scale^2
+	float wanted = m_scale * std::sqrt(1.0f / ratio);
+	float step = glm::clamp(wanted - m_scale, -m_settings.maxStepDown, m_settings.maxStepUp);
+	float scale = glm::clamp(m_scale + step, m_settings.minScale, m_settings.maxScale);
+
+	// snap to 1/64 so we do not chase the noise with tiny viewport changes
+	scale = std::floor(scale * 64.0f + 0.5f) / 64.0f;
+	scale = glm::clamp(scale, m_settings.minScale, m_settings.maxScale);
+
+	if (scale != m_scale) {
+		m_scale = scale;
+		m_smoothedGpuTime = 0.0f; // previous samples measured another resolution
+		m_cooldown = m_settings.cooldownFrames;
+	}
+
+	m_overFrames = 0;
+	m_underFrames = 0;
+}
+
+void RenderScaler::beginFrame() {
+
+	readTimers();
+
+	unsigned int slot = m_frameIndex % GPU_TIMER_QUERIES;
+	glBeginQuery(GL_TIME_ELAPSED, m_queries[slot]);
+	m_queryIssued[slot] = true;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+	glViewport(0, 0, getRenderWidth(), getRenderHeight());
+}
+
+void RenderScaler::endFrame() {
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, m_windowWidth, m_windowHeight);
+
+	glDisable(GL_DEPTH_TEST);
+
+	m_upscaleShader.use();
+	m_upscaleShader.setInt("source", 0);
+	m_upscaleShader.setVec2("sourceSize", (float)m_targetWidth, (float)m_targetHeight);
+	m_upscaleShader.setVec2("renderSize", (float)getRenderWidth(), (float)getRenderHeight());
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, m_colorTexture);
+
+	glBindVertexArray(m_emptyVAO);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glEnable(GL_DEPTH_TEST);
+
+	glEndQuery(GL_TIME_ELAPSED);
+	m_frameIndex++;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <algorithm>
+
+#include "shader.h"
+
+// Number of GPU timer queries in flight : results are read back a few frames late so we never stall on them
+const int GPU_TIMER_QUERIES = 4;
+
+struct RenderScaleSettings {
+	float targetFrameTime = 1000.0f / 60.0f; // milliseconds of GPU time we aim for
+	float minScale = 0.5f;
+	float maxScale = 1.0f;
+	float overBudget = 1.05f;  // measured / target ratio above which we scale down
+	float underBudget = 0.80f; // measured / target ratio below which we scale up
+	int settleFrames = 10;     // frames the ratio must stay out of the dead zone before we react (hysteresis)
+	int cooldownFrames = 30;   // frames to wait after a change, so the timers measure the new resolution
+	float maxStepDown = 0.10f;
+	float maxStepUp = 0.05f;   // grow slower than we shrink to avoid oscillating around the budget
+};
+
+/**
+ * Renders the scene into an offscreen target whose resolution follows the measured GPU frame time,
+ * then upscales it to the window.
+ * The target is allocated once at maxScale so changing the scale only changes the viewport.
+ **/
+class RenderScaler {
+
+	private:
+		RenderScaleSettings m_settings;
+
+		int m_windowWidth;
+		int m_windowHeight;
+		int m_targetWidth;  // allocated size of the offscreen target
+		int m_targetHeight;
+
+		float m_scale;
+		float m_gpuTime;        // last measured GPU frame time (ms)
+		float m_smoothedGpuTime;
+		int m_overFrames;
+		int m_underFrames;
+		int m_cooldown;
+
+		GLuint m_fbo;
+		GLuint m_colorTexture;
+		GLuint m_depthRenderbuffer;
+		GLuint m_emptyVAO; // fullscreen triangle is generated from gl_VertexID
+
+		GLuint m_queries[GPU_TIMER_QUERIES];
+		bool m_queryIssued[GPU_TIMER_QUERIES];
+		unsigned int m_frameIndex;
+
+		Shader m_upscaleShader;
+
+		void createTarget();
+		void destroyTarget();
+		void readTimers();
+		void updateScale();
+
+	public:
+		RenderScaler(int windowWidth, int windowHeight, RenderScaleSettings settings = RenderScaleSettings());
+		~RenderScaler();
+
+		RenderScaler(const RenderScaler &) = delete;
+		RenderScaler &operator=(const RenderScaler &) = delete;
+
+		// no-op when the size did not change
+		void resize(int windowWidth, int windowHeight);
+
+		// bind the offscreen target at the current scale and start timing the frame
+		void beginFrame();
+		// upscale to the default framebuffer and stop timing the frame
+		void endFrame();
+
+		inline float getScale() const {
+			return m_scale;
+		}
+
+		inline int getRenderWidth() const {
+			return std::max(1, (int)(m_windowWidth * m_scale));
+		}
+
+		inline int getRenderHeight() const {
+			return std::max(1, (int)(m_windowHeight * m_scale));
+		}
+
+		inline float getGpuTime() const {
+			return m_gpuTime;
+		}
+
+		inline const RenderScaleSettings &getSettings() const {
+			return m_settings;
+		}
+
+};
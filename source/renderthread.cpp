@@ -0,0 +1,138 @@
+#include "renderthread.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+
+RenderThread::RenderThread(GLFWwindow *window, RenderThreadSettings settings) :
+	m_window(window),
+	m_stopping(false) {
+
+	unsigned int packetCount = std::max(settings.packetCount, 1u);
+	for (unsigned int i = 0; i < packetCount; i++) {
+		m_packets.emplace_back(new FramePacket(settings.arenaBytes));
+		m_free.push_back(m_packets.back().get());
+	}
+}
+
+RenderThread::~RenderThread() {
+	stop();
+}
+
+void RenderThread::start(std::function<void(const FramePacket &)> render) {
+
+	if (m_thread.joinable()) {
+		return;
+	}
+
+	m_render = std::move(render);
+	m_stopping = false;
+
+	// a context is current on one thread at a time
+	glfwMakeContextCurrent(nullptr);
+	m_thread = std::thread(&RenderThread::threadLoop, this);
+}
+
+void RenderThread::stop() {
+
+	if (!m_thread.joinable()) {
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_packetReady.notify_all();
+	m_thread.join();
+
+	glfwMakeContextCurrent(m_window);
+}
+
+void RenderThread::threadLoop() {
+
+	glfwMakeContextCurrent(m_window);
+
+	while (true) {
+
+		FramePacket *packet;
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_packetReady.wait(lock, [this] { return m_stopping || !m_ready.empty(); });
+
+			// submitted packets are still drawn when stopping
+			if (m_ready.empty()) {
+				break;
+			}
+
+			packet = m_ready.front();
+			m_ready.pop_front();
+			m_stats.renderWaitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		m_render(*packet);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(packet);
+			m_stats.frames++;
+		}
+		m_packetFreed.notify_one();
+	}
+
+	glfwMakeContextCurrent(nullptr);
+}
+
+FramePacket &RenderThread::beginPacket() {
+
+	FramePacket *packet;
+	{
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_packetFreed.wait(lock, [this] { return !m_free.empty(); });
+
+		packet = m_free.front();
+		m_free.pop_front();
+		m_stats.mainWaitMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// the render thread is done with everything in it
+	packet->arena.reset();
+	packet->width = 0;
+	packet->height = 0;
+	packet->objects = nullptr;
+	packet->objectCount = 0;
+	packet->visible = nullptr;
+	packet->visibleCount = 0;
+	packet->palette = nullptr;
+	packet->paletteCount = 0;
+	packet->memoryReport = false;
+	packet->captureFrame = false;
+
+	return *packet;
+}
+
+void RenderThread::submitPacket(FramePacket &packet) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		// only the main thread allocates : the counters of the other arenas are stable
+		m_stats.arenaHighWater = 0;
+		m_stats.arenaOverflows = 0;
+		for (size_t i = 0; i < m_packets.size(); i++) {
+			m_stats.arenaHighWater = std::max(m_stats.arenaHighWater, m_packets[i]->arena.getHighWater());
+			m_stats.arenaOverflows += m_packets[i]->arena.getOverflows();
+		}
+		m_ready.push_back(&packet);
+	}
+	m_packetReady.notify_one();
+}
+
+RenderThreadStats RenderThread::getStats() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
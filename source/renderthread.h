@@ -0,0 +1,109 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "lineararena.h"
+#include "shaderdata.h"
+
+struct GLFWwindow;
+
+struct RenderThreadSettings {
+	unsigned int packetCount = 2;        // frames the main thread may build ahead of the one being rendered, at least 1
+	size_t arenaBytes = 4 * 1024 * 1024; // per packet : object data, visible list and bone palettes
+};
+
+struct RenderThreadStats {
+	unsigned long long frames = 0;
+	double mainWaitMilliseconds = 0.0;   // last beginPacket, > 0 when the render thread is the bottleneck
+	double renderWaitMilliseconds = 0.0; // last wait for a packet, > 0 when the main thread is
+	size_t arenaHighWater = 0;           // largest packet so far
+	unsigned long long arenaOverflows = 0;
+};
+
+/**
+ * Everything the render thread needs for one frame, built by the main thread and read only afterwards.
+ * Arrays live in the packet's arena : they stay valid until the packet is handed out again by beginPacket.
+ **/
+struct FramePacket {
+	int width = 0;   // framebuffer size
+	int height = 0;
+	CameraData camera;
+	float fovY = 0.0f; // radians
+	LightData lights;
+
+	// one per object, the index is the object slot
+	const ObjectData *objects = nullptr;
+	uint32_t objectCount = 0;
+	// slots that passed occlusion culling
+	const uint32_t *visible = nullptr;
+	uint32_t visibleCount = 0;
+	// skinning matrices, ObjectData::boneOffset indexes them
+	const BoneMatrix *palette = nullptr;
+	size_t paletteCount = 0;
+
+	bool memoryReport = false; // MemoryTracker::dumpJson, it queries the driver
+	bool captureFrame = false; // debug builds : GL capture of this frame
+
+	LinearArena arena;
+
+	explicit FramePacket(size_t arenaBytes) : arena(arenaBytes) {
+	}
+};
+
+/**
+ * Thread owning the GL context.
+ * The main thread polls input, updates the simulation and fills a FramePacket (beginPacket / submitPacket); the
+ * render thread turns packets into GL calls in order. packetCount packets cycle between the two : with 2, frame N+1
+ * is built while frame N is submitted, and beginPacket blocks when the main thread gets further ahead, which bounds
+ * the latency between input and display.
+ * Both threads may run parallelFor at the same time; a system with per thread scratch must only be used by one of
+ * them, since they both get thread index 0.
+ **/
+class RenderThread {
+
+	private:
+		GLFWwindow *m_window;
+		std::vector<std::unique_ptr<FramePacket>> m_packets;
+		std::deque<FramePacket *> m_free;
+		std::deque<FramePacket *> m_ready;
+
+		std::thread m_thread;
+		std::mutex m_mutex;
+		std::condition_variable m_packetFreed;
+		std::condition_variable m_packetReady;
+		bool m_stopping;
+
+		std::function<void(const FramePacket &)> m_render;
+		RenderThreadStats m_stats;
+
+		void threadLoop();
+
+	public:
+		RenderThread(GLFWwindow *window, RenderThreadSettings settings = RenderThreadSettings());
+		~RenderThread();
+
+		RenderThread(const RenderThread &) = delete;
+		RenderThread &operator=(const RenderThread &) = delete;
+
+		// main thread, context current : the context moves to the render thread, which calls render for every packet.
+		// Until stop(), anything touching GL (driver queries included) has to travel in the packet
+		void start(std::function<void(const FramePacket &)> render);
+
+		// main thread : renders the packets already submitted, then the context is current on the calling thread again
+		void stop();
+
+		// main thread : a free packet with an empty arena, blocks while packetCount packets are queued or rendering
+		FramePacket &beginPacket();
+
+		void submitPacket(FramePacket &packet);
+
+		RenderThreadStats getStats();
+
+};
@@ -0,0 +1,121 @@
+#include "ringbuffer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "memorytracker.h"
+
+RingBuffer::RingBuffer(GLsizeiptr bytesPerFrame)
+	: m_buffer(0), m_mapped(nullptr), m_region(0), m_head(0), m_uniformAlignment(256), m_storageAlignment(256) {
+
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &m_uniformAlignment);
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &m_storageAlignment);
+
+	// regions must start on an offset valid for both uniform and storage bindings
+	GLsizeiptr alignment = std::max(m_uniformAlignment, m_storageAlignment);
+	m_regionSize = (bytesPerFrame + alignment - 1) / alignment * alignment;
+
+	GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glCreateBuffers(1, &m_buffer);
+	glNamedBufferStorage(m_buffer, m_regionSize * RING_BUFFER_FRAMES, nullptr, flags);
+	m_mapped = (char *)glMapNamedBufferRange(m_buffer, 0, m_regionSize * RING_BUFFER_FRAMES, flags);
+
+	MemoryTracker::get().trackBuffer(m_buffer, m_regionSize * RING_BUFFER_FRAMES, MemoryCategory::STREAMING, "RingBuffer");
+
+	if (!m_mapped) {
+		std::cout << "ERROR::RING_BUFFER::MAPPING_FAILED" << std::endl;
+	}
+
+	for (unsigned int i = 0; i < RING_BUFFER_FRAMES; i++) {
+		m_fences[i] = 0;
+	}
+}
+
+RingBuffer::~RingBuffer() {
+	for (unsigned int i = 0; i < RING_BUFFER_FRAMES; i++) {
+		if (m_fences[i]) {
+			glDeleteSync(m_fences[i]);
+		}
+	}
+	glUnmapNamedBuffer(m_buffer);
+	glDeleteBuffers(1, &m_buffer);
+	MemoryTracker::get().untrackBuffer(m_buffer);
+}
+
+void RingBuffer::beginFrame() {
+
+	m_region = (m_region + 1) % RING_BUFFER_FRAMES;
+	m_head = 0;
+	m_stats.frames++;
+
+	GLsync fence = m_fences[m_region];
+	if (!fence) {
+		return;
+	}
+
+	// cheap check first : most frames the GPU is already done with this region
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status == GL_TIMEOUT_EXPIRED) {
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+		// flush so the fence is guaranteed to signal, then wait in 1ms steps
+		GLbitfield waitFlags = GL_SYNC_FLUSH_COMMANDS_BIT;
+		do {
+			status = glClientWaitSync(fence, waitFlags, 1000000);
+			waitFlags = 0;
+		} while (status == GL_TIMEOUT_EXPIRED);
+
+		double waited = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		m_stats.fenceWaits++;
+		m_stats.fenceWaitMilliseconds += waited;
+		m_stats.lastWaitMilliseconds = waited;
+	} else {
+		m_stats.lastWaitMilliseconds = 0.0;
+	}
+
+	if (status == GL_WAIT_FAILED) {
+		std::cout << "ERROR::RING_BUFFER::FENCE_WAIT_FAILED" << std::endl;
+	}
+
+	glDeleteSync(fence);
+	m_fences[m_region] = 0;
+}
+
+void RingBuffer::endFrame() {
+	m_fences[m_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	m_stats.highWaterBytes = std::max(m_stats.highWaterBytes, (size_t)m_head);
+}
+
+RingAllocation RingBuffer::allocate(GLsizeiptr size, GLsizeiptr alignment) {
+
+	RingAllocation allocation;
+
+	GLsizeiptr start = (m_head + alignment - 1) / alignment * alignment;
+	if (!m_mapped || start + size > m_regionSize) {
+		m_stats.overflows++;
+		return allocation;
+	}
+
+	m_head = start + size;
+
+	allocation.offset = m_region * m_regionSize + start;
+	allocation.data = m_mapped + allocation.offset;
+	allocation.size = size;
+	return allocation;
+}
+
+bool RingBuffer::upload(GLenum target, GLuint binding, const void *data, GLsizeiptr size) {
+
+	RingAllocation allocation = target == GL_SHADER_STORAGE_BUFFER ? allocateStorage(size) : allocateUniform(size);
+	if (!allocation.data) {
+		return false;
+	}
+
+	std::memcpy(allocation.data, data, size);
+	glBindBufferRange(target, binding, m_buffer, allocation.offset, allocation.size);
+	return true;
+}
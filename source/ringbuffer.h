@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <cstddef>
+
+// Frames the CPU may record ahead of the GPU : each one writes into its own region of the buffer
+const unsigned int RING_BUFFER_FRAMES = 3;
+
+struct RingAllocation {
+	void *data = nullptr;    // persistently mapped, write only
+	GLintptr offset = 0;     // for glBindBufferRange
+	GLsizeiptr size = 0;
+};
+
+struct RingBufferStats {
+	unsigned long long frames = 0;
+	unsigned long long fenceWaits = 0;   // beginFrame had to block on the GPU
+	double fenceWaitMilliseconds = 0.0;  // total time blocked
+	double lastWaitMilliseconds = 0.0;
+	size_t highWaterBytes = 0;           // largest amount allocated in a single frame
+	unsigned long long overflows = 0;    // allocations that did not fit in the frame region
+};
+
+/**
+ * Per frame dynamic data (camera, lights, transforms) uploaded through a persistently mapped buffer.
+ * The buffer is split in RING_BUFFER_FRAMES regions; a fence guards each region so the CPU never writes
+ * into memory the GPU may still read, and never needs glBufferData / glBufferSubData.
+ **/
+class RingBuffer {
+
+	private:
+		GLuint m_buffer;
+		char *m_mapped;
+		GLsizeiptr m_regionSize;
+		GLsync m_fences[RING_BUFFER_FRAMES];
+		unsigned int m_region;
+		GLsizeiptr m_head; // offset inside the current region
+		GLint m_uniformAlignment;
+		GLint m_storageAlignment;
+		RingBufferStats m_stats;
+
+	public:
+		explicit RingBuffer(GLsizeiptr bytesPerFrame);
+		~RingBuffer();
+
+		RingBuffer(const RingBuffer &) = delete;
+		RingBuffer &operator=(const RingBuffer &) = delete;
+
+		// wait until the GPU is done with the region we are about to reuse
+		void beginFrame();
+		// fence the commands that read this frame's region
+		void endFrame();
+
+		// linear sub allocation in the current region, returns an empty allocation when the region is full
+		RingAllocation allocate(GLsizeiptr size, GLsizeiptr alignment);
+
+		inline RingAllocation allocateUniform(GLsizeiptr size) {
+			return allocate(size, m_uniformAlignment);
+		}
+
+		inline RingAllocation allocateStorage(GLsizeiptr size) {
+			return allocate(size, m_storageAlignment);
+		}
+
+		// copy and bind in one go : target is GL_UNIFORM_BUFFER or GL_SHADER_STORAGE_BUFFER
+		bool upload(GLenum target, GLuint binding, const void *data, GLsizeiptr size);
+
+		inline GLint getUniformAlignment() const {
+			return m_uniformAlignment;
+		}
+
+		inline GLuint getBuffer() const {
+			return m_buffer;
+		}
+
+		inline const RingBufferStats &getStats() const {
+			return m_stats;
+		}
+
+};
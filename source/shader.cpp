@@ -1,52 +1,36 @@
 #include "shader.h"
 
+#include "vfs.h"
+
 Shader::Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath) {
 
-	// 1. retrieve the vertex/fragment source code from filePath
+	// 1. retrieve the vertex/fragment source code from filePath (pack file or loose file)
 	std::string vertexCode;
 	std::string fragmentCode;
 	std::string geometryCode;
-	std::ifstream vShaderFile;
-	std::ifstream fShaderFile;
-	std::ifstream gShaderFile;
-
-	// ensure ifstream objects can throw exceptions:
-	vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-	gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-	try {
-
-		// open files
-		vShaderFile.open(vertexPath);
-		fShaderFile.open(fragmentPath);
-		std::stringstream vShaderStream, fShaderStream;
-
-		// read file's buffer contents into streams
-		vShaderStream << vShaderFile.rdbuf();
-		fShaderStream << fShaderFile.rdbuf();
-
-		// close file handlers
-		vShaderFile.close();
-		fShaderFile.close();
-
-		// convert stream into string
-		vertexCode = vShaderStream.str();
-		fragmentCode = fShaderStream.str();
-
-		// if geometry shader path is present, also load a geometry shader
-		if (geometryPath != nullptr) {
-			gShaderFile.open(geometryPath);
-			std::stringstream gShaderStream;
-			gShaderStream << gShaderFile.rdbuf();
-			gShaderFile.close();
-			geometryCode = gShaderStream.str();
-		}
+	FileData vShaderFile;
+	FileData fShaderFile;
+	FileData gShaderFile;
+
+	if (Vfs::get().readFile(vertexPath, vShaderFile) && Vfs::get().readFile(fragmentPath, fShaderFile)) {
 
-	} catch (std::ifstream::failure &e) {
+		// convert file contents into string
+		vertexCode.assign(vShaderFile.data, vShaderFile.size);
+		fragmentCode.assign(fShaderFile.data, fShaderFile.size);
+
+	} else {
 		std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
 	}
 
+	// if geometry shader path is present, also load a geometry shader
+	if (geometryPath != nullptr) {
+		if (Vfs::get().readFile(geometryPath, gShaderFile)) {
+			geometryCode.assign(gShaderFile.data, gShaderFile.size);
+		} else {
+			std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+		}
+	}
+
 	const char *vShaderCode = vertexCode.c_str();
 	const char *fShaderCode = fragmentCode.c_str();
 
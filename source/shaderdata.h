@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// C++ mirrors of the std140 uniform blocks declared in shader.vert / shader.frag
+// vec3 members are followed by padding (or by a float that std140 packs in the same 16 bytes)
+
+const unsigned int CAMERA_BLOCK_BINDING = 0;
+const unsigned int OBJECT_BLOCK_BINDING = 1;
+const unsigned int LIGHT_BLOCK_BINDING = 2;
+// std430 storage block of the skinning matrices, every animated instance of the frame
+const unsigned int BONE_PALETTE_BINDING = 3;
+
+// sampler2DArray of the baked static lights, above the material units
+const unsigned int LIGHTMAP_TEXTURE_UNIT = 15;
+
+#define NR_POINT_LIGHTS 4
+
+struct CameraData {
+	glm::mat4 proj;
+	glm::mat4 view;
+	glm::vec3 viewPos;
+	float padding;
+};
+
+struct ObjectData {
+	glm::mat4 model;
+	glm::mat4 normalMatrix; // only the upper 3x3 is used, a mat3 would be padded to 3 vec4 anyway
+	int lightmapLayer;      // -1 : every light evaluated live
+	int boneOffset;         // first BoneMatrix of the instance in the palette, -1 : not skinned
+	int padding[2];
+};
+
+// skinning matrix with its last row (0 0 0 1) dropped : the 3 rows of the transposed affine transform
+struct BoneMatrix {
+	glm::vec4 rows[3];
+};
+
+struct DirectionalLightData {
+	glm::vec3 direction; float padding0;
+	glm::vec3 ambient;   float padding1;
+	glm::vec3 diffuse;   float padding2;
+	glm::vec3 specular;  float padding3;
+};
+
+struct PointLightData {
+	glm::vec3 position; float padding0;
+	glm::vec3 ambient;  float padding1;
+	glm::vec3 diffuse;  float padding2;
+	glm::vec3 specular;
+	float constant;
+	float linear;
+	float quadratic;
+	float padding3[2];
+};
+
+struct SpotLightData {
+	glm::vec3 position;  float padding0;
+	glm::vec3 direction;
+	float cutOff;
+	float outerCutOff;   float padding1[3];
+	glm::vec3 ambient;   float padding2;
+	glm::vec3 diffuse;   float padding3;
+	glm::vec3 specular;
+	float constant;
+	float linear;
+	float quadratic;
+	float padding4[2];
+};
+
+struct LightData {
+	DirectionalLightData dirLight;
+	PointLightData pointLights[NR_POINT_LIGHTS];
+	SpotLightData spotLight;
+};
+
+static_assert(sizeof(CameraData) == 144, "CameraData does not match the std140 layout");
+static_assert(sizeof(ObjectData) == 144, "ObjectData does not match the std140 layout");
+static_assert(sizeof(BoneMatrix) == 48, "BoneMatrix does not match the std430 layout");
+static_assert(sizeof(DirectionalLightData) == 64, "DirectionalLight does not match the std140 layout");
+static_assert(sizeof(PointLightData) == 80 && offsetof(PointLightData, constant) == 60, "PointLight does not match the std140 layout");
+static_assert(sizeof(SpotLightData) == 112 && offsetof(SpotLightData, ambient) == 48 && offsetof(SpotLightData, constant) == 92, "SpotLight does not match the std140 layout");
+static_assert(sizeof(LightData) == 64 + 4 * 80 + 112, "LightData does not match the std140 layout");
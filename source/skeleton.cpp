@@ -0,0 +1,283 @@
+#include "skeleton.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <set>
+
+static glm::mat4 toMat4(const aiMatrix4x4 &matrix) {
+	// Assimp is row major
+	glm::mat4 result;
+	for (int row = 0; row < 4; row++) {
+		for (int column = 0; column < 4; column++) {
+			result[column][row] = matrix[row][column];
+		}
+	}
+	return result;
+}
+
+static inline glm::quat toQuat(const aiQuaternion &q) {
+	return glm::quat(q.w, q.x, q.y, q.z);
+}
+
+int Skeleton::findJoint(const std::string &name) const {
+	for (size_t i = 0; i < joints.size(); i++) {
+		if (joints[i].name == name) {
+			return (int)i;
+		}
+	}
+	return -1;
+}
+
+// true when the node or one of its children is a bone
+static bool markJoints(const aiNode *node, const std::set<std::string> &bones, std::set<const aiNode *> &needed) {
+	bool need = bones.count(node->mName.C_Str()) > 0;
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		need = markJoints(node->mChildren[i], bones, needed) || need;
+	}
+	if (need) {
+		needed.insert(node);
+	}
+	return need;
+}
+
+static void addJoints(const aiNode *node, int parent, const std::set<const aiNode *> &needed, Skeleton &skeleton) {
+
+	if (!needed.count(node)) {
+		return;
+	}
+
+	SkeletonJoint joint;
+	joint.name = node->mName.C_Str();
+	joint.parent = parent;
+	joint.inverseBind = glm::mat4(1.0f);
+
+	aiVector3D scaling, position;
+	aiQuaternion rotation;
+	node->mTransformation.Decompose(scaling, rotation, position);
+	joint.bindTranslation = glm::vec3(position.x, position.y, position.z);
+	joint.bindRotation = toQuat(rotation);
+	joint.bindScale = (scaling.x + scaling.y + scaling.z) / 3.0f;
+
+	int index = (int)skeleton.joints.size();
+	skeleton.joints.push_back(joint);
+
+	for (unsigned int i = 0; i < node->mNumChildren; i++) {
+		addJoints(node->mChildren[i], index, needed, skeleton);
+	}
+}
+
+bool ImportSkeleton(const aiScene *scene, Skeleton &skeleton) {
+
+	skeleton = Skeleton();
+
+	std::set<std::string> bones;
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+		const aiMesh *mesh = scene->mMeshes[m];
+		for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+			bones.insert(mesh->mBones[b]->mName.C_Str());
+		}
+	}
+	if (bones.empty()) {
+		return false;
+	}
+
+	std::set<const aiNode *> needed;
+	markJoints(scene->mRootNode, bones, needed);
+	addJoints(scene->mRootNode, -1, needed, skeleton);
+
+	if (skeleton.joints.size() > MAX_SKELETON_JOINTS) {
+		std::cout << "ERROR::SKELETON::TOO_MANY_JOINTS " << skeleton.joints.size() << std::endl;
+		skeleton = Skeleton();
+		return false;
+	}
+
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++) {
+		const aiMesh *mesh = scene->mMeshes[m];
+		for (unsigned int b = 0; b < mesh->mNumBones; b++) {
+			int joint = skeleton.findJoint(mesh->mBones[b]->mName.C_Str());
+			skeleton.joints[joint].inverseBind = toMat4(mesh->mBones[b]->mOffsetMatrix);
+		}
+	}
+
+	skeleton.globalInverse = glm::inverse(toMat4(scene->mRootNode->mTransformation));
+	return true;
+}
+
+// linear keys : the last key before time and the blend factor towards the next one
+template<typename Key>
+static unsigned int findKey(const Key *keys, unsigned int count, double time, float &factor) {
+	factor = 0.0f;
+	if (count < 2 || time <= keys[0].mTime) {
+		return 0;
+	}
+	unsigned int next = 1;
+	while (next < count && keys[next].mTime < time) {
+		next++;
+	}
+	if (next == count) {
+		return count - 1;
+	}
+	double span = keys[next].mTime - keys[next - 1].mTime;
+	factor = span > 0.0 ? (float)((time - keys[next - 1].mTime) / span) : 0.0f;
+	return next - 1;
+}
+
+static int16_t quantize(float value) {
+	return (int16_t)std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+void ImportAnimations(const aiScene *scene, const Skeleton &skeleton, std::vector<AnimationClip> &clips) {
+
+	clips.clear();
+
+	unsigned int jointCount = (unsigned int)skeleton.joints.size();
+	if (jointCount == 0) {
+		return;
+	}
+
+	for (unsigned int a = 0; a < scene->mNumAnimations; a++) {
+
+		const aiAnimation *animation = scene->mAnimations[a];
+		double ticksPerSecond = animation->mTicksPerSecond > 0.0 ? animation->mTicksPerSecond : 25.0;
+
+		AnimationClip clip;
+		clip.name = animation->mName.C_Str();
+		clip.duration = (float)(animation->mDuration / ticksPerSecond);
+		clip.frameCount = std::max(2u, (unsigned int)std::ceil(clip.duration * ANIMATION_SAMPLE_RATE) + 1);
+		clip.jointCount = jointCount;
+		clip.keys.resize((size_t)clip.frameCount * jointCount);
+
+		// the channel animating each joint, if any
+		std::vector<const aiNodeAnim *> channels(jointCount, nullptr);
+		for (unsigned int c = 0; c < animation->mNumChannels; c++) {
+			int joint = skeleton.findJoint(animation->mChannels[c]->mNodeName.C_Str());
+			if (joint >= 0) {
+				channels[joint] = animation->mChannels[c];
+			}
+		}
+
+		for (unsigned int joint = 0; joint < jointCount; joint++) {
+
+			const SkeletonJoint &bind = skeleton.joints[joint];
+			const aiNodeAnim *channel = channels[joint];
+			glm::quat previous = bind.bindRotation;
+
+			for (unsigned int frame = 0; frame < clip.frameCount; frame++) {
+
+				double time = std::min((double)frame / ANIMATION_SAMPLE_RATE, (double)clip.duration) * ticksPerSecond;
+
+				glm::vec3 translation = bind.bindTranslation;
+				glm::quat rotation = bind.bindRotation;
+				float scale = bind.bindScale;
+
+				if (channel) {
+					float factor;
+					if (channel->mNumPositionKeys > 0) {
+						unsigned int key = findKey(channel->mPositionKeys, channel->mNumPositionKeys, time, factor);
+						aiVector3D value = channel->mPositionKeys[key].mValue;
+						if (factor > 0.0f) {
+							value = value + (channel->mPositionKeys[key + 1].mValue - value) * factor;
+						}
+						translation = glm::vec3(value.x, value.y, value.z);
+					}
+					if (channel->mNumRotationKeys > 0) {
+						unsigned int key = findKey(channel->mRotationKeys, channel->mNumRotationKeys, time, factor);
+						aiQuaternion value = channel->mRotationKeys[key].mValue;
+						if (factor > 0.0f) {
+							aiQuaternion::Interpolate(value, channel->mRotationKeys[key].mValue, channel->mRotationKeys[key + 1].mValue, factor);
+						}
+						rotation = toQuat(value.Normalize());
+					}
+					if (channel->mNumScalingKeys > 0) {
+						unsigned int key = findKey(channel->mScalingKeys, channel->mNumScalingKeys, time, factor);
+						aiVector3D value = channel->mScalingKeys[key].mValue;
+						if (factor > 0.0f) {
+							value = value + (channel->mScalingKeys[key + 1].mValue - value) * factor;
+						}
+						scale = (value.x + value.y + value.z) / 3.0f;
+					}
+				}
+
+				// same hemisphere as the previous frame : sampling lerps without flipping
+				if (rotation.x * previous.x + rotation.y * previous.y + rotation.z * previous.z + rotation.w * previous.w < 0.0f) {
+					rotation = glm::quat(-rotation.w, -rotation.x, -rotation.y, -rotation.z);
+				}
+				previous = rotation;
+
+				JointKey &out = clip.keys[(size_t)frame * jointCount + joint];
+				out.rotation[0] = quantize(rotation.x);
+				out.rotation[1] = quantize(rotation.y);
+				out.rotation[2] = quantize(rotation.z);
+				out.rotation[3] = quantize(rotation.w);
+				out.translation[0] = translation.x;
+				out.translation[1] = translation.y;
+				out.translation[2] = translation.z;
+				out.scale = scale;
+			}
+		}
+
+		clips.push_back(std::move(clip));
+	}
+}
+
+void SampleClip(const AnimationClip &clip, float time, float weight, JointPose *out) {
+
+	if (clip.frameCount == 0) {
+		return;
+	}
+
+	float wrapped = clip.duration > 0.0f ? std::fmod(time, clip.duration) : 0.0f;
+	if (wrapped < 0.0f) {
+		wrapped += clip.duration;
+	}
+	float position = wrapped * ANIMATION_SAMPLE_RATE;
+	unsigned int frame = std::min((unsigned int)position, clip.frameCount - 2);
+	float factor = std::min(position - frame, 1.0f);
+
+	const JointKey *a = &clip.keys[(size_t)frame * clip.jointCount];
+	const JointKey *b = a + clip.jointCount;
+	const float dequantize = 1.0f / 32767.0f;
+
+	for (unsigned int joint = 0; joint < clip.jointCount; joint++) {
+
+		glm::vec3 translation(
+			a[joint].translation[0] + (b[joint].translation[0] - a[joint].translation[0]) * factor,
+			a[joint].translation[1] + (b[joint].translation[1] - a[joint].translation[1]) * factor,
+			a[joint].translation[2] + (b[joint].translation[2] - a[joint].translation[2]) * factor);
+		float scale = a[joint].scale + (b[joint].scale - a[joint].scale) * factor;
+
+		// nlerp : keys are close and in the same hemisphere
+		float x = (a[joint].rotation[0] + (b[joint].rotation[0] - a[joint].rotation[0]) * factor) * dequantize;
+		float y = (a[joint].rotation[1] + (b[joint].rotation[1] - a[joint].rotation[1]) * factor) * dequantize;
+		float z = (a[joint].rotation[2] + (b[joint].rotation[2] - a[joint].rotation[2]) * factor) * dequantize;
+		float w = (a[joint].rotation[3] + (b[joint].rotation[3] - a[joint].rotation[3]) * factor) * dequantize;
+
+		JointPose &pose = out[joint];
+		if (weight >= 1.0f) {
+			pose.translation = translation;
+			pose.scale = scale;
+		} else {
+			pose.translation = pose.translation + (translation - pose.translation) * weight;
+			pose.scale = pose.scale + (scale - pose.scale) * weight;
+			// blend with the pose already there, on its side of the hemisphere
+			if (x * pose.rotation.x + y * pose.rotation.y + z * pose.rotation.z + w * pose.rotation.w < 0.0f) {
+				x = -x;
+				y = -y;
+				z = -z;
+				w = -w;
+			}
+			x = pose.rotation.x + (x - pose.rotation.x) * weight;
+			y = pose.rotation.y + (y - pose.rotation.y) * weight;
+			z = pose.rotation.z + (z - pose.rotation.z) * weight;
+			w = pose.rotation.w + (w - pose.rotation.w) * weight;
+		}
+
+		float length = std::sqrt(x * x + y * y + z * z + w * w);
+		float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+		pose.rotation = glm::quat(w * inverse, x * inverse, y * inverse, z * inverse);
+		if (length == 0.0f) {
+			pose.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <assimp/scene.h>
+
+// bone ids are stored in a byte per vertex
+const unsigned int MAX_SKELETON_JOINTS = 256;
+// clips are resampled at this rate on import, sampling is then a plain index
+const float ANIMATION_SAMPLE_RATE = 30.0f;
+
+struct SkeletonJoint {
+	std::string name;
+	int parent;             // always before the joint, -1 for the root
+	glm::mat4 inverseBind;  // mesh space to joint space, identity for joints no vertex uses
+	glm::vec3 bindTranslation;
+	glm::quat bindRotation;
+	float bindScale;        // uniform : non uniform joint scale is averaged
+};
+
+struct Skeleton {
+	std::vector<SkeletonJoint> joints;
+	glm::mat4 globalInverse = glm::mat4(1.0f); // inverse of the scene root transform
+
+	int findJoint(const std::string &name) const;
+
+	inline bool empty() const {
+		return joints.empty();
+	}
+};
+
+// local transform of one joint at one frame : 24 bytes
+struct JointKey {
+	int16_t rotation[4];    // quaternion x y z w, snorm16
+	float translation[3];
+	float scale;
+};
+
+/**
+ * Animation resampled at ANIMATION_SAMPLE_RATE for every joint of the skeleton it was imported with.
+ * Keys are frame major (keys[frame * jointCount + joint]) so a pose reads one contiguous block per frame,
+ * and consecutive rotations share a hemisphere so they can be blended without a sign check.
+ **/
+struct AnimationClip {
+	std::string name;
+	float duration = 0.0f;       // seconds
+	unsigned int frameCount = 0;
+	unsigned int jointCount = 0;
+	std::vector<JointKey> keys;
+};
+
+struct JointPose {
+	glm::vec3 translation;
+	glm::quat rotation;
+	float scale;
+};
+
+// joints are the bones of the meshes and their ancestors, parents first; false without bones
+bool ImportSkeleton(const aiScene *scene, Skeleton &skeleton);
+
+void ImportAnimations(const aiScene *scene, const Skeleton &skeleton, std::vector<AnimationClip> &clips);
+
+// local pose of every joint at time (seconds, wrapped), blended over what out already holds by weight (1 : replace)
+void SampleClip(const AnimationClip &clip, float time, float weight, JointPose *out);
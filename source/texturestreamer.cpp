@@ -0,0 +1,462 @@
+#include "texturestreamer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+
+#include "stb_image.h"
+#include "vfs.h"
+#include "memorytracker.h"
+
+static void getFormats(int components, GLenum &internalFormat, GLenum &format) {
+	if (components == 1) {
+		internalFormat = GL_R8;
+		format = GL_RED;
+	} else if (components == 2) {
+		internalFormat = GL_RG8;
+		format = GL_RG;
+	} else if (components == 3) {
+		internalFormat = GL_RGB8;
+		format = GL_RGB;
+	} else {
+		internalFormat = GL_RGBA8;
+		format = GL_RGBA;
+	}
+}
+
+static inline int getLevelSize(int size, int mip) {
+	return std::max(1, size >> mip);
+}
+
+// 2x2 box filter, odd sizes repeat their last row / column
+static void downsample(const unsigned char *src, int width, int height, int components, std::vector<unsigned char> &dst) {
+
+	int dstWidth = getLevelSize(width, 1);
+	int dstHeight = getLevelSize(height, 1);
+	dst.resize((size_t)dstWidth * dstHeight * components);
+
+	for (int y = 0; y < dstHeight; y++) {
+		const unsigned char *row0 = src + (size_t)std::min(2 * y, height - 1) * width * components;
+		const unsigned char *row1 = src + (size_t)std::min(2 * y + 1, height - 1) * width * components;
+		unsigned char *out = &dst[(size_t)y * dstWidth * components];
+
+		for (int x = 0; x < dstWidth; x++) {
+			int x0 = std::min(2 * x, width - 1) * components;
+			int x1 = std::min(2 * x + 1, width - 1) * components;
+			for (int c = 0; c < components; c++) {
+				out[x * components + c] = (unsigned char)((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+			}
+		}
+	}
+}
+
+TextureStreamer &TextureStreamer::get() {
+	static TextureStreamer instance;
+	return instance;
+}
+
+TextureStreamer::TextureStreamer() : m_jobs(nullptr), m_frame(1), m_viewPosition(0.0f), m_projectionScale(1.0f), m_pendingLoads(0) {
+}
+
+void TextureStreamer::init(JobSystem &jobs, StreamSettings settings) {
+	m_jobs = &jobs;
+	m_settings = settings;
+}
+
+void TextureStreamer::shutdown() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_loadDone.wait(lock, [this] { return m_pendingLoads == 0; });
+	m_loaded.clear();
+}
+
+void TextureStreamer::prepare(TextureData &texture) const {
+
+	if (!isEnabled() || !texture.pixels || texture.mip != 0) {
+		return;
+	}
+
+	int levels = MemoryTracker::getMipCount(texture.width, texture.height);
+	int tailMip = 0;
+	while (tailMip + 1 < levels && std::max(getLevelSize(texture.width, tailMip), getLevelSize(texture.height, tailMip)) > m_settings.tailSize) {
+		tailMip++;
+	}
+
+	if (tailMip == 0) {
+		return;
+	}
+
+	std::vector<unsigned char> current;
+	std::vector<unsigned char> next;
+	downsample(texture.pixels, texture.width, texture.height, texture.components, current);
+	for (int mip = 1; mip < tailMip; mip++) {
+		downsample(current.data(), getLevelSize(texture.width, mip), getLevelSize(texture.height, mip), texture.components, next);
+		current.swap(next);
+	}
+
+	// stbi_image_free is free() : keep the buffer compatible with every place that releases pixels
+	stbi_image_free(texture.pixels);
+	texture.pixels = (unsigned char *)std::malloc(current.size());
+	std::memcpy(texture.pixels, current.data(), current.size());
+	texture.mip = tailMip;
+}
+
+StreamHandle TextureStreamer::create(TextureData &data, const std::string &directory, const std::string &owner) {
+
+	if (!data.pixels) {
+		return INVALID_STREAM;
+	}
+
+	StreamedTexture texture;
+	texture.path = directory + '/' + data.path;
+	texture.owner = owner;
+	texture.width = data.width;
+	texture.height = data.height;
+	texture.components = data.components;
+	texture.levels = MemoryTracker::getMipCount(data.width, data.height);
+	texture.tailMip = std::max(data.mip, 0);
+	while (texture.tailMip + 1 < texture.levels && std::max(getLevelSize(data.width, texture.tailMip), getLevelSize(data.height, texture.tailMip)) > m_settings.tailSize) {
+		texture.tailMip++;
+	}
+	texture.residentMip = data.mip;
+	texture.requestedMip = texture.tailMip;
+	texture.desiredMip = data.mip;
+	texture.lastUsedFrame = m_frame;
+
+	GLenum internalFormat, format;
+	getFormats(texture.components, internalFormat, format);
+
+	int width = getLevelSize(texture.width, data.mip);
+	int height = getLevelSize(texture.height, data.mip);
+
+	glCreateTextures(GL_TEXTURE_2D, 1, &texture.id);
+	glTextureStorage2D(texture.id, texture.levels - data.mip, internalFormat, width, height);
+	glTextureParameteri(texture.id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(texture.id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(texture.id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(texture.id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glTextureSubImage2D(texture.id, 0, 0, 0, width, height, format, GL_UNSIGNED_BYTE, data.pixels);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glGenerateTextureMipmap(texture.id);
+
+	MemoryTracker::get().trackTexture(texture.id, width, height, internalFormat, texture.levels - data.mip, MemoryCategory::TEXTURE, owner);
+
+	stbi_image_free(data.pixels);
+	data.pixels = nullptr;
+
+	m_textures.push_back(texture);
+	return (StreamHandle)(m_textures.size() - 1);
+}
+
+size_t TextureStreamer::getBytes(const StreamedTexture &texture, int mip) const {
+	GLenum internalFormat, format;
+	getFormats(texture.components, internalFormat, format);
+	return MemoryTracker::getTextureBytes(getLevelSize(texture.width, mip), getLevelSize(texture.height, mip), internalFormat, texture.levels - mip);
+}
+
+void TextureStreamer::setView(const glm::vec3 &position, float fovY, float screenHeight) {
+	m_viewPosition = position;
+	m_projectionScale = screenHeight / (2.0f * std::tan(fovY * 0.5f));
+}
+
+void TextureStreamer::requestMip(StreamHandle handle, int mip) {
+
+	StreamedTexture &texture = m_textures[handle];
+	mip = std::max(0, std::min(mip, texture.tailMip));
+
+	if (texture.lastUsedFrame != m_frame) {
+		texture.lastUsedFrame = m_frame;
+		texture.requestedMip = mip;
+	} else {
+		texture.requestedMip = std::min(texture.requestedMip, mip);
+	}
+}
+
+void TextureStreamer::requestMips(const Mesh &mesh, const glm::mat4 &model) {
+
+	if (!isEnabled()) {
+		return;
+	}
+
+	float scale = std::max(glm::length(glm::vec3(model[0])), std::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+	glm::vec3 center = glm::vec3(model * glm::vec4((mesh.boundsMin + mesh.boundsMax) * 0.5f, 1.0f));
+	float radius = glm::length(mesh.boundsMax - mesh.boundsMin) * 0.5f * scale;
+
+	// closest point of the bounding sphere : the part of the mesh that needs the most texels
+	float distance = std::max(glm::length(center - m_viewPosition) - radius, 0.1f);
+	float pixelsPerWorldUnit = m_projectionScale / distance;
+	float worldUnitsPerUv = mesh.uvDensity * scale;
+
+	for (size_t i = 0; i < mesh.textures.size(); i++) {
+
+		StreamHandle handle = mesh.textures[i].stream;
+		if (handle == INVALID_STREAM) {
+			continue;
+		}
+
+		const StreamedTexture &texture = m_textures[handle];
+		int mip = texture.tailMip;
+		if (worldUnitsPerUv > 0.0f) {
+			float texelsPerWorldUnit = std::sqrt((float)texture.width * texture.height) / worldUnitsPerUv;
+			float texelsPerPixel = texelsPerWorldUnit / pixelsPerWorldUnit;
+			mip = texelsPerPixel <= 1.0f ? 0 : (int)std::floor(std::log2(texelsPerPixel));
+		}
+
+		requestMip(handle, mip);
+	}
+}
+
+void TextureStreamer::startLoad(StreamHandle handle) {
+
+	StreamedTexture &texture = m_textures[handle];
+	texture.loading = true;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_pendingLoads++;
+	}
+
+	std::string path = texture.path;
+	int width = texture.width;
+	int height = texture.height;
+	int components = texture.components;
+	int targetMip = texture.desiredMip;
+	int residentMip = texture.residentMip;
+
+	m_jobs->submit([this, handle, path, width, height, components, targetMip, residentMip]() {
+
+		LoadResult result;
+		result.handle = handle;
+		result.mip = targetMip;
+		result.residentMip = residentMip;
+		result.success = false;
+
+		FileData file;
+		if (Vfs::get().readFile(path, file)) {
+			int decodedWidth, decodedHeight, decodedComponents;
+			unsigned char *pixels = stbi_load_from_memory((const stbi_uc *)file.data, (int)file.size, &decodedWidth, &decodedHeight, &decodedComponents, components);
+
+			if (pixels && decodedWidth == width && decodedHeight == height) {
+				std::vector<unsigned char> current(pixels, pixels + (size_t)width * height * components);
+				std::vector<unsigned char> next;
+
+				// walk down the chain from mip 0, keep [targetMip, residentMip)
+				for (int mip = 0; mip < residentMip; mip++) {
+					if (mip + 1 < residentMip) {
+						downsample(current.data(), getLevelSize(width, mip), getLevelSize(height, mip), components, next);
+					}
+					if (mip >= targetMip) {
+						result.levels.push_back(std::move(current));
+					}
+					current.swap(next);
+				}
+				result.success = true;
+			}
+			stbi_image_free(pixels);
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loaded.push_back(std::move(result));
+		m_pendingLoads--;
+		m_loadDone.notify_all();
+	});
+}
+
+void TextureStreamer::reallocate(StreamedTexture &texture, int mip, const std::vector<std::vector<unsigned char>> *levels) {
+
+	GLenum internalFormat, format;
+	getFormats(texture.components, internalFormat, format);
+
+	int width = getLevelSize(texture.width, mip);
+	int height = getLevelSize(texture.height, mip);
+
+	GLuint id;
+	glCreateTextures(GL_TEXTURE_2D, 1, &id);
+	glTextureStorage2D(id, texture.levels - mip, internalFormat, width, height);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTextureParameteri(id, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTextureParameteri(id, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+	glTextureParameteri(id, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// mips both chains have : GPU to GPU copy
+	for (int level = std::max(mip, texture.residentMip); level < texture.levels; level++) {
+		glCopyImageSubData(texture.id, GL_TEXTURE_2D, level - texture.residentMip, 0, 0, 0,
+			id, GL_TEXTURE_2D, level - mip, 0, 0, 0,
+			getLevelSize(texture.width, level), getLevelSize(texture.height, level), 1);
+	}
+
+	// finer mips decoded by the workers
+	if (levels) {
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		for (int level = mip; level < texture.residentMip; level++) {
+			glTextureSubImage2D(id, level - mip, 0, 0, getLevelSize(texture.width, level), getLevelSize(texture.height, level),
+				format, GL_UNSIGNED_BYTE, (*levels)[level - mip].data());
+		}
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+
+	MemoryTracker::get().untrackTexture(texture.id);
+	glDeleteTextures(1, &texture.id);
+
+	texture.id = id;
+	texture.residentMip = mip;
+	MemoryTracker::get().trackTexture(id, width, height, internalFormat, texture.levels - mip, MemoryCategory::TEXTURE, texture.owner);
+}
+
+void TextureStreamer::update() {
+
+	if (!isEnabled()) {
+		return;
+	}
+
+	StreamStats stats;
+
+	// 1. the mip every texture should have
+	size_t wantedBytes = 0;
+	for (size_t i = 0; i < m_textures.size(); i++) {
+		StreamedTexture &texture = m_textures[i];
+
+		int desired;
+		if (texture.lastUsedFrame == m_frame) {
+			if (texture.requestedMip > texture.residentMip) {
+				// coarser is enough : wait a bit before dropping, the object may come back closer
+				if (texture.coarserSinceFrame == 0) {
+					texture.coarserSinceFrame = m_frame;
+				}
+				desired = m_frame - texture.coarserSinceFrame >= m_settings.evictDelayFrames ? texture.requestedMip : texture.residentMip;
+			} else {
+				texture.coarserSinceFrame = 0;
+				desired = texture.requestedMip;
+			}
+		} else {
+			// not drawn lately : back to the tail
+			desired = m_frame - texture.lastUsedFrame >= m_settings.evictDelayFrames ? texture.tailMip : texture.residentMip;
+		}
+
+		if (texture.failed) {
+			desired = std::max(desired, texture.residentMip);
+		}
+
+		texture.desiredMip = desired;
+		wantedBytes += getBytes(texture, desired);
+	}
+	stats.wantedBytes = wantedBytes;
+
+	// 2. over budget : least recently used textures give up their finest mips first
+	if (wantedBytes > m_settings.budgetBytes) {
+
+		std::vector<size_t> order(m_textures.size());
+		for (size_t i = 0; i < order.size(); i++) {
+			order[i] = i;
+		}
+		std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+			return m_textures[a].lastUsedFrame < m_textures[b].lastUsedFrame;
+		});
+
+		size_t total = wantedBytes;
+		for (size_t i = 0; i < order.size() && total > m_settings.budgetBytes; i++) {
+			StreamedTexture &texture = m_textures[order[i]];
+			while (total > m_settings.budgetBytes && texture.desiredMip < texture.tailMip) {
+				total -= getBytes(texture, texture.desiredMip) - getBytes(texture, texture.desiredMip + 1);
+				texture.desiredMip++;
+			}
+		}
+	}
+
+	// 3. finer mips decoded by the workers, within the upload budget (always at least one)
+	std::deque<LoadResult> loaded;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		loaded.swap(m_loaded);
+	}
+
+	size_t uploadedBytes = 0;
+	while (!loaded.empty()) {
+
+		LoadResult &result = loaded.front();
+		StreamedTexture &texture = m_textures[result.handle];
+
+		if (!result.success) {
+			std::cout << "ERROR::TEXTURE_STREAMER::LOAD_FAILED " << texture.path << std::endl;
+			texture.failed = true;
+			texture.loading = false;
+			loaded.pop_front();
+			continue;
+		}
+
+		// the budget may have changed while decoding : skip the levels no longer wanted
+		int mip = std::max(result.mip, texture.desiredMip);
+		size_t bytes = 0;
+		for (size_t j = mip - result.mip; j < result.levels.size(); j++) {
+			bytes += result.levels[j].size();
+		}
+
+		if (stats.upgrades > 0 && uploadedBytes + bytes > m_settings.uploadBytesPerFrame) {
+			break;
+		}
+
+		if (mip < texture.residentMip && result.residentMip == texture.residentMip) {
+			result.levels.erase(result.levels.begin(), result.levels.begin() + (mip - result.mip));
+			reallocate(texture, mip, &result.levels);
+			uploadedBytes += bytes;
+			stats.upgrades++;
+		}
+
+		texture.loading = false;
+		loaded.pop_front();
+	}
+
+	// what did not fit goes back in front of the queue
+	if (!loaded.empty()) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_loaded.insert(m_loaded.begin(), std::make_move_iterator(loaded.begin()), std::make_move_iterator(loaded.end()));
+	}
+
+	// 4. evictions : the coarser chain is copied from the current one, nothing to decode
+	for (size_t i = 0; i < m_textures.size(); i++) {
+		StreamedTexture &texture = m_textures[i];
+		if (!texture.loading && texture.desiredMip > texture.residentMip) {
+			reallocate(texture, texture.desiredMip, nullptr);
+			stats.downgrades++;
+		}
+	}
+
+	// 5. start decoding finer mips, the textures drawn most recently first
+	std::vector<size_t> candidates;
+	for (size_t i = 0; i < m_textures.size(); i++) {
+		const StreamedTexture &texture = m_textures[i];
+		if (!texture.loading && !texture.failed && texture.desiredMip < texture.residentMip) {
+			candidates.push_back(i);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](size_t a, size_t b) {
+		const StreamedTexture &ta = m_textures[a];
+		const StreamedTexture &tb = m_textures[b];
+		if (ta.lastUsedFrame != tb.lastUsedFrame) {
+			return ta.lastUsedFrame > tb.lastUsedFrame;
+		}
+		return ta.residentMip - ta.desiredMip > tb.residentMip - tb.desiredMip;
+	});
+
+	unsigned int pendingLoads;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		pendingLoads = m_pendingLoads;
+	}
+	for (size_t i = 0; i < candidates.size() && pendingLoads < m_settings.maxPendingLoads; i++) {
+		startLoad((StreamHandle)candidates[i]);
+		pendingLoads++;
+	}
+
+	for (size_t i = 0; i < m_textures.size(); i++) {
+		stats.residentBytes += getBytes(m_textures[i], m_textures[i].residentMip);
+	}
+	stats.pendingLoads = pendingLoads;
+	m_lastStats = stats;
+
+	m_frame++;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glad\glad.h>
+#include <glm\glm.hpp>
+
+#include "model.h"
+#include "jobsystem.h"
+
+typedef int StreamHandle;
+const StreamHandle INVALID_STREAM = -1;
+
+struct StreamSettings {
+	size_t budgetBytes = 256 * 1024 * 1024;     // VRAM for every streamed texture together
+	int tailSize = 64;                          // mips this size and smaller stay resident
+	size_t uploadBytesPerFrame = 8 * 1024 * 1024;
+	unsigned int maxPendingLoads = 4;           // decodes running on the workers at once
+	unsigned int evictDelayFrames = 120;        // frames a finer mip is kept once it is no longer needed
+};
+
+struct StreamStats {
+	size_t residentBytes = 0;
+	size_t wantedBytes = 0;      // before the budget trims it
+	unsigned int pendingLoads = 0;
+	unsigned int upgrades = 0;   // during the last update
+	unsigned int downgrades = 0;
+};
+
+/**
+ * Mip streaming for material textures.
+ * Textures start with only their tail mips (<= tailSize) resident. Every frame the renderer reports the finest
+ * mip each visible mesh needs from its screen size and UV density; update() then decodes the missing mips on
+ * the workers and drops the unneeded ones, least recently used first when the budget is tight.
+ * Storage is immutable (glTexStorage2D) : a residency change allocates the new chain, copies the mips both
+ * have with glCopyImageSubData and uploads the rest, so the GL id of a stream changes : resolve it with getId().
+ **/
+class TextureStreamer {
+
+	private:
+		struct StreamedTexture {
+			GLuint id = 0;
+			std::string path;    // full path, re-decoded when finer mips are needed
+			std::string owner;
+			int width = 0;       // mip 0
+			int height = 0;
+			int components = 0;
+			int levels = 0;      // full chain
+			int tailMip = 0;
+			int residentMip = 0; // finest mip in GPU memory
+			int requestedMip = 0;
+			int desiredMip = 0;
+			unsigned int lastUsedFrame = 0;
+			unsigned int coarserSinceFrame = 0; // first frame the requested mip became coarser than resident
+			bool loading = false;
+			bool failed = false;  // the source could not be decoded again : stays at what is resident
+		};
+
+		// finer mips decoded by a worker, waiting for the GL thread
+		struct LoadResult {
+			StreamHandle handle;
+			int mip;             // finest level in levels
+			int residentMip;     // levels stop right above the mip resident when the load started
+			std::vector<std::vector<unsigned char>> levels;
+			bool success;
+		};
+
+		JobSystem *m_jobs;
+		StreamSettings m_settings;
+		std::vector<StreamedTexture> m_textures;
+		unsigned int m_frame;
+
+		glm::vec3 m_viewPosition;
+		float m_projectionScale; // pixels covered by one world unit at distance 1
+
+		std::mutex m_mutex;
+		std::condition_variable m_loadDone;
+		std::deque<LoadResult> m_loaded;
+		unsigned int m_pendingLoads;
+
+		StreamStats m_lastStats;
+
+		TextureStreamer();
+
+		void startLoad(StreamHandle handle);
+		void reallocate(StreamedTexture &texture, int mip, const std::vector<std::vector<unsigned char>> *levels);
+		size_t getBytes(const StreamedTexture &texture, int mip) const;
+
+	public:
+		static TextureStreamer &get();
+
+		// GL thread, before any model is loaded
+		void init(JobSystem &jobs, StreamSettings settings = StreamSettings());
+		// waits for the decodes still running
+		void shutdown();
+
+		inline bool isEnabled() const {
+			return m_jobs != nullptr;
+		}
+
+		// any thread : shrinks decoded pixels to the tail mip, everything finer is streamed later
+		void prepare(TextureData &texture) const;
+
+		// GL thread : takes ownership of the prepared pixels
+		StreamHandle create(TextureData &texture, const std::string &directory, const std::string &owner);
+
+		inline GLuint getId(StreamHandle handle) const {
+			return m_textures[handle].id;
+		}
+
+		// once per frame, before the requests
+		void setView(const glm::vec3 &position, float fovY, float screenHeight);
+		void requestMip(StreamHandle handle, int mip);
+		// finest mip every texture of the mesh needs, drawn with the model matrix
+		void requestMips(const Mesh &mesh, const glm::mat4 &model);
+
+		// GL thread, once per frame after the requests
+		void update();
+
+		inline const StreamStats &getStats() const {
+			return m_lastStats;
+		}
+
+		inline void setSettings(const StreamSettings &settings) {
+			m_settings = settings;
+		}
+
+		inline const StreamSettings &getSettings() const {
+			return m_settings;
+		}
+
+};
@@ -0,0 +1,137 @@
+#include "transformsystem.h"
+
+#include <algorithm>
+
+TransformHandle TransformSystem::create(const glm::vec3 &position, const glm::quat &rotation, const glm::vec3 &scale) {
+
+	TransformHandle handle = (TransformHandle)m_world.size();
+
+	m_positionX.push_back(position.x);
+	m_positionY.push_back(position.y);
+	m_positionZ.push_back(position.z);
+
+	glm::quat q = glm::normalize(rotation);
+	m_rotationX.push_back(q.x);
+	m_rotationY.push_back(q.y);
+	m_rotationZ.push_back(q.z);
+	m_rotationW.push_back(q.w);
+
+	m_scaleX.push_back(scale.x);
+	m_scaleY.push_back(scale.y);
+	m_scaleZ.push_back(scale.z);
+
+	m_world.push_back(glm::mat4(1.0f));
+	m_normal.push_back(glm::mat3(1.0f));
+	m_dirty.push_back(0);
+
+	markDirty(handle);
+	return handle;
+}
+
+void TransformSystem::markDirty(TransformHandle handle) {
+	if (!m_dirty[handle]) {
+		m_dirty[handle] = 1;
+		m_dirtyList.push_back(handle);
+	}
+}
+
+void TransformSystem::setPosition(TransformHandle handle, const glm::vec3 &position) {
+	m_positionX[handle] = position.x;
+	m_positionY[handle] = position.y;
+	m_positionZ[handle] = position.z;
+	markDirty(handle);
+}
+
+void TransformSystem::setRotation(TransformHandle handle, const glm::quat &rotation) {
+	glm::quat q = glm::normalize(rotation);
+	m_rotationX[handle] = q.x;
+	m_rotationY[handle] = q.y;
+	m_rotationZ[handle] = q.z;
+	m_rotationW[handle] = q.w;
+	markDirty(handle);
+}
+
+void TransformSystem::setScale(TransformHandle handle, const glm::vec3 &scale) {
+	m_scaleX[handle] = scale.x;
+	m_scaleY[handle] = scale.y;
+	m_scaleZ[handle] = scale.z;
+	markDirty(handle);
+}
+
+void TransformSystem::update(JobSystem &jobs) {
+
+	if (m_dirtyList.empty()) {
+		return;
+	}
+
+	const TransformHandle *dirty = m_dirtyList.data();
+
+	if (m_dirtyList.size() < TRANSFORM_PARALLEL_THRESHOLD) {
+		computeRange(dirty, m_dirtyList.size());
+	} else {
+		jobs.parallelFor(m_dirtyList.size(), TRANSFORM_BATCH_SIZE, [this, dirty](size_t begin, size_t end, unsigned int) {
+			computeRange(dirty + begin, end - begin);
+		});
+	}
+
+	for (size_t i = 0; i < m_dirtyList.size(); i++) {
+		m_dirty[m_dirtyList[i]] = 0;
+	}
+	m_dirtyList.clear();
+}
+
+void TransformSystem::computeRange(const TransformHandle *handles, size_t count) {
+
+	const unsigned int W = TRANSFORM_SIMD_WIDTH;
+
+	for (size_t base = 0; base < count; base += W) {
+
+		unsigned int lanes = (unsigned int)std::min<size_t>(W, count - base);
+
+		// gather : dirty entries are scattered, copy them into contiguous lanes
+		float qx[W], qy[W], qz[W], qw[W], sx[W], sy[W], sz[W];
+		for (unsigned int l = 0; l < W; l++) {
+			// pad the last batch with the last valid entry, keeps the loops below branch free
+			TransformHandle h = handles[base + std::min(l, lanes - 1)];
+			qx[l] = m_rotationX[h]; qy[l] = m_rotationY[h]; qz[l] = m_rotationZ[h]; qw[l] = m_rotationW[h];
+			sx[l] = m_scaleX[h]; sy[l] = m_scaleY[h]; sz[l] = m_scaleZ[h];
+		}
+
+		// rotation matrix from the quaternion, rN_M is column N row M
+		float r0_0[W], r0_1[W], r0_2[W], r1_0[W], r1_1[W], r1_2[W], r2_0[W], r2_1[W], r2_2[W];
+		for (unsigned int l = 0; l < W; l++) {
+			float xx = qx[l] * qx[l], yy = qy[l] * qy[l], zz = qz[l] * qz[l];
+			float xy = qx[l] * qy[l], xz = qx[l] * qz[l], yz = qy[l] * qz[l];
+			float wx = qw[l] * qx[l], wy = qw[l] * qy[l], wz = qw[l] * qz[l];
+
+			r0_0[l] = 1.0f - 2.0f * (yy + zz); r0_1[l] = 2.0f * (xy + wz);        r0_2[l] = 2.0f * (xz - wy);
+			r1_0[l] = 2.0f * (xy - wz);        r1_1[l] = 1.0f - 2.0f * (xx + zz); r1_2[l] = 2.0f * (yz + wx);
+			r2_0[l] = 2.0f * (xz + wy);        r2_1[l] = 2.0f * (yz - wx);        r2_2[l] = 1.0f - 2.0f * (xx + yy);
+		}
+
+		// world = T * R * S scales the columns of R
+		// normal = transpose(inverse(R * S)) = R * inverse(S) divides them, no general inverse needed
+		float isx[W], isy[W], isz[W];
+		for (unsigned int l = 0; l < W; l++) {
+			isx[l] = 1.0f / sx[l];
+			isy[l] = 1.0f / sy[l];
+			isz[l] = 1.0f / sz[l];
+		}
+
+		// scatter
+		for (unsigned int l = 0; l < lanes; l++) {
+			TransformHandle h = handles[base + l];
+
+			glm::mat4 &world = m_world[h];
+			world[0] = glm::vec4(r0_0[l] * sx[l], r0_1[l] * sx[l], r0_2[l] * sx[l], 0.0f);
+			world[1] = glm::vec4(r1_0[l] * sy[l], r1_1[l] * sy[l], r1_2[l] * sy[l], 0.0f);
+			world[2] = glm::vec4(r2_0[l] * sz[l], r2_1[l] * sz[l], r2_2[l] * sz[l], 0.0f);
+			world[3] = glm::vec4(m_positionX[h], m_positionY[h], m_positionZ[h], 1.0f);
+
+			glm::mat3 &normal = m_normal[h];
+			normal[0] = glm::vec3(r0_0[l] * isx[l], r0_1[l] * isx[l], r0_2[l] * isx[l]);
+			normal[1] = glm::vec3(r1_0[l] * isy[l], r1_1[l] * isy[l], r1_2[l] * isy[l]);
+			normal[2] = glm::vec3(r2_0[l] * isz[l], r2_1[l] * isz[l], r2_2[l] * isz[l]);
+		}
+	}
+}
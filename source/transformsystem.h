@@ -0,0 +1,71 @@
+#pragma once
+
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "jobsystem.h"
+
+typedef unsigned int TransformHandle;
+
+// Entries are processed this many at a time, in plain loops over local arrays the compiler can vectorize
+const unsigned int TRANSFORM_SIMD_WIDTH = 8;
+// Below this many dirty entries, waking the workers costs more than it saves
+const size_t TRANSFORM_PARALLEL_THRESHOLD = 2048;
+const size_t TRANSFORM_BATCH_SIZE = 512;
+
+/**
+ * Position / rotation / scale of every object, stored as structure of arrays.
+ * World and normal matrices are only rebuilt for entries that changed since the last update().
+ **/
+class TransformSystem {
+
+	private:
+		// local transform, one array per component
+		std::vector<float> m_positionX, m_positionY, m_positionZ;
+		std::vector<float> m_rotationX, m_rotationY, m_rotationZ, m_rotationW;
+		std::vector<float> m_scaleX, m_scaleY, m_scaleZ;
+
+		// derived data, read by the renderer
+		std::vector<glm::mat4> m_world;
+		std::vector<glm::mat3> m_normal;
+
+		std::vector<unsigned char> m_dirty;
+		std::vector<TransformHandle> m_dirtyList;
+
+		void markDirty(TransformHandle handle);
+		void computeRange(const TransformHandle *handles, size_t count);
+
+	public:
+		TransformHandle create(const glm::vec3 &position, const glm::quat &rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3 &scale = glm::vec3(1.0f));
+
+		void setPosition(TransformHandle handle, const glm::vec3 &position);
+		void setRotation(TransformHandle handle, const glm::quat &rotation);
+		void setScale(TransformHandle handle, const glm::vec3 &scale);
+
+		// rebuild the matrices of dirty entries, spread across the workers when there are many
+		void update(JobSystem &jobs);
+
+		inline glm::vec3 getPosition(TransformHandle handle) const {
+			return glm::vec3(m_positionX[handle], m_positionY[handle], m_positionZ[handle]);
+		}
+
+		inline const glm::mat4 &getWorldMatrix(TransformHandle handle) const {
+			return m_world[handle];
+		}
+
+		// transpose(inverse(mat3(world))), computed once here instead of for every vertex
+		inline const glm::mat3 &getNormalMatrix(TransformHandle handle) const {
+			return m_normal[handle];
+		}
+
+		inline size_t size() const {
+			return m_world.size();
+		}
+
+		inline size_t getDirtyCount() const {
+			return m_dirtyList.size();
+		}
+
+};
@@ -0,0 +1,167 @@
+#include "vfs.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+Vfs &Vfs::get() {
+	static Vfs instance;
+	return instance;
+}
+
+bool Vfs::mount(const std::string &packPath) {
+
+	std::unique_ptr<PackFile> pack(new PackFile());
+	if (!pack->open(packPath)) {
+		return false;
+	}
+
+	std::cout << "Mounted " << packPath << " (" << pack->getEntryCount() << " files)" << std::endl;
+	m_packs.push_back(std::move(pack));
+	return true;
+}
+
+std::string Vfs::normalize(const std::string &path) {
+
+	std::string result = path;
+	std::replace(result.begin(), result.end(), '\\', '/');
+
+	while (result.compare(0, 2, "./") == 0) {
+		result.erase(0, 2);
+	}
+
+	size_t position;
+	while ((position = result.find("/./")) != std::string::npos) {
+		result.erase(position, 2);
+	}
+	while ((position = result.find("//")) != std::string::npos) {
+		result.erase(position, 1);
+	}
+
+	return result;
+}
+
+bool Vfs::readFile(const std::string &path, FileData &file) const {
+
+	std::string name = normalize(path);
+
+	for (size_t i = m_packs.size(); i-- > 0;) {
+		const PackEntry *entry = m_packs[i]->find(name);
+		if (entry) {
+			return m_packs[i]->read(*entry, file, m_jobs);
+		}
+	}
+
+	// loose file
+	std::ifstream in(name, std::ios::binary | std::ios::ate);
+	if (!in) {
+		return false;
+	}
+
+	std::streamsize size = in.tellg();
+	in.seekg(0);
+	file.storage.resize((size_t)size);
+	if (size > 0 && !in.read(file.storage.data(), size)) {
+		file.storage.clear();
+		return false;
+	}
+
+	file.data = file.storage.data();
+	file.size = file.storage.size();
+	return true;
+}
+
+bool Vfs::exists(const std::string &path) const {
+
+	std::string name = normalize(path);
+
+	for (size_t i = 0; i < m_packs.size(); i++) {
+		if (m_packs[i]->find(name)) {
+			return true;
+		}
+	}
+
+	std::ifstream in(name, std::ios::binary);
+	return in.good();
+}
+
+
+size_t VfsIOStream::Read(void *buffer, size_t size, size_t count) {
+
+	if (size == 0) {
+		return 0;
+	}
+
+	size_t available = (m_file.size - m_position) / size;
+	count = std::min(count, available);
+	if (count == 0) {
+		return 0;
+	}
+	std::memcpy(buffer, m_file.data + m_position, size * count);
+	m_position += size * count;
+	return count;
+}
+
+size_t VfsIOStream::Write(const void *buffer, size_t size, size_t count) {
+	// read only
+	return 0;
+}
+
+aiReturn VfsIOStream::Seek(size_t offset, aiOrigin origin) {
+
+	size_t target;
+	if (origin == aiOrigin_SET) {
+		target = offset;
+	} else if (origin == aiOrigin_CUR) {
+		target = m_position + offset;
+	} else {
+		target = m_file.size + offset;
+	}
+
+	if (target > m_file.size) {
+		return aiReturn_FAILURE;
+	}
+
+	m_position = target;
+	return aiReturn_SUCCESS;
+}
+
+size_t VfsIOStream::Tell() const {
+	return m_position;
+}
+
+size_t VfsIOStream::FileSize() const {
+	return m_file.size;
+}
+
+void VfsIOStream::Flush() {
+}
+
+
+bool VfsIOSystem::Exists(const char *path) const {
+	return Vfs::get().exists(path);
+}
+
+char VfsIOSystem::getOsSeparator() const {
+	return '/';
+}
+
+Assimp::IOStream *VfsIOSystem::Open(const char *path, const char *mode) {
+
+	// writing is not supported
+	if (std::strchr(mode, 'w')) {
+		return nullptr;
+	}
+
+	FileData file;
+	if (!Vfs::get().readFile(path, file)) {
+		return nullptr;
+	}
+
+	return new VfsIOStream(std::move(file));
+}
+
+void VfsIOSystem::Close(Assimp::IOStream *stream) {
+	delete stream;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <assimp/IOStream.hpp>
+#include <assimp/IOSystem.hpp>
+
+#include "packfile.h"
+#include "jobsystem.h"
+
+/**
+ * Virtual file system : files are looked up in the mounted packs first (last mounted wins),
+ * then on disk, so loose files keep working while developing.
+ * Mount everything before loading starts : lookups are then read only and safe from any thread.
+ **/
+class Vfs {
+
+	private:
+		std::vector<std::unique_ptr<PackFile>> m_packs;
+		JobSystem *m_jobs;
+
+		Vfs() : m_jobs(nullptr) {
+		}
+
+	public:
+		static Vfs &get();
+
+		bool mount(const std::string &packPath);
+
+		// used to decompress the chunks of big entries in parallel
+		inline void setJobSystem(JobSystem *jobs) {
+			m_jobs = jobs;
+		}
+
+		bool readFile(const std::string &path, FileData &file) const;
+		bool exists(const std::string &path) const;
+
+		// forward slashes, no "./" : the form names are stored with in the packs
+		static std::string normalize(const std::string &path);
+
+};
+
+// lets Assimp open the model and everything it references (.mtl, ...) through the Vfs
+class VfsIOStream : public Assimp::IOStream {
+
+	private:
+		FileData m_file;
+		size_t m_position;
+
+	public:
+		explicit VfsIOStream(FileData &&file) : m_file(std::move(file)), m_position(0) {
+		}
+
+		size_t Read(void *buffer, size_t size, size_t count) override;
+		size_t Write(const void *buffer, size_t size, size_t count) override;
+		aiReturn Seek(size_t offset, aiOrigin origin) override;
+		size_t Tell() const override;
+		size_t FileSize() const override;
+		void Flush() override;
+
+};
+
+class VfsIOSystem : public Assimp::IOSystem {
+
+	public:
+		bool Exists(const char *path) const override;
+		char getOsSeparator() const override;
+		Assimp::IOStream *Open(const char *path, const char *mode = "rb") override;
+		void Close(Assimp::IOStream *stream) override;
+
+};